@@ -0,0 +1,72 @@
+#include "Arena.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+Arena::Arena(size_t capacity_) {
+	resize(capacity_);
+}
+
+Arena::~Arena() {
+	delete[] memory;
+	memory = nullptr;
+}
+
+void *Arena::allocate(size_t bytes, size_t alignment) {
+	//(memory itself is aligned for any type, so aligning the offset aligns the pointer)
+	size_t start = (used + alignment - 1) & ~(alignment - 1);
+	if (start > capacity || bytes > capacity - start) {
+		throw std::runtime_error("arena of " + std::to_string(capacity) + " bytes can't fit " + std::to_string(bytes) + " more (" + std::to_string(used) + " used).");
+	}
+	used = start + bytes;
+	if (used > high_water) high_water = used;
+	return memory + start;
+}
+
+void Arena::reset() {
+	used = 0;
+}
+
+void Arena::resize(size_t capacity_) {
+	delete[] memory;
+	memory = nullptr;
+	capacity = 0;
+	used = 0;
+	memory = new char[capacity_];
+	capacity = capacity_;
+}
+
+//------- heap allocation counting -------
+
+static std::atomic< uint64_t > &allocation_count() {
+	//(a function-local static, so it exists before any other static's constructor allocates)
+	static std::atomic< uint64_t > count(0);
+	return count;
+}
+
+uint64_t heap_allocations() {
+	return allocation_count().load(std::memory_order_relaxed);
+}
+
+//every other form of new and delete (nothrow, sized) is implemented by the standard library in terms of these:
+void *operator new(size_t bytes) {
+	allocation_count().fetch_add(1, std::memory_order_relaxed);
+	void *ret = std::malloc(bytes ? bytes : 1);
+	if (!ret) throw std::bad_alloc();
+	return ret;
+}
+
+void *operator new[](size_t bytes) {
+	return operator new(bytes);
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+	operator delete(ptr);
+}
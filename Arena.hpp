@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//Arena is a fixed block of memory handed out front to back, and reclaimed all at once by reset(),
+// for data that lives only until a known point (the end of a frame, the next level):
+// allocating is a pointer bump, freeing is free, and the heap is never touched after construction.
+// It is bounded: allocating past its capacity throws, so a size mistake is found rather than hidden.
+struct Arena {
+	explicit Arena(size_t capacity);
+	~Arena();
+
+	Arena(Arena const &) = delete;
+	Arena &operator=(Arena const &) = delete;
+
+	//'bytes' of memory aligned to 'alignment' (a power of two), valid until the next reset(); throws if the arena is full:
+	void *allocate(size_t bytes, size_t alignment);
+
+	//make the whole arena available again (everything allocated from it is invalidated):
+	void reset();
+
+	//discard everything and replace the block with one of 'capacity' bytes (allocates; not for every frame):
+	void resize(size_t capacity);
+
+	char *memory = nullptr;
+	size_t capacity = 0;
+	size_t used = 0;
+	size_t high_water = 0; //most ever used between resets, for sizing
+};
+
+//ArenaAllocator lets standard containers live in an Arena; deallocation does nothing (reset() reclaims everything),
+// so reserve() what a container will need up front, or each time it grows it strands its old storage in the arena:
+template< typename T >
+struct ArenaAllocator {
+	typedef T value_type;
+
+	explicit ArenaAllocator(Arena *arena_) : arena(arena_) { }
+	template< typename U >
+	ArenaAllocator(ArenaAllocator< U > const &other) : arena(other.arena) { }
+
+	T *allocate(size_t count) {
+		return static_cast< T * >(arena->allocate(count * sizeof(T), alignof(T)));
+	}
+	void deallocate(T *, size_t) { }
+
+	Arena *arena;
+};
+
+template< typename T, typename U >
+bool operator==(ArenaAllocator< T > const &a, ArenaAllocator< U > const &b) { return a.arena == b.arena; }
+template< typename T, typename U >
+bool operator!=(ArenaAllocator< T > const &a, ArenaAllocator< U > const &b) { return a.arena != b.arena; }
+
+template< typename T >
+using ArenaVector = std::vector< T, ArenaAllocator< T > >;
+
+//heap allocations (calls to the global operator new) made so far by the whole program, on any thread:
+// (Arena.cpp replaces operator new to count them, so the profiler can show whether frames allocate)
+uint64_t heap_allocations();
@@ -0,0 +1,93 @@
+#include "BatchSim.hpp"
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+//boards per chunk of work handed to the thread pool:
+// (large enough to amortize taking a chunk, small enough to balance across threads)
+#define STEP_GRAIN 2048
+
+//boards tested for pickups per adjacency kernel call (the results go in a stack buffer):
+#define PICKUP_BLOCK 256
+
+BatchSim::BatchSim(uint32_t count_, uint64_t seed, glm::uvec2 board_size_) : count(count_), board_size(board_size_), kernels(&best_batch_kernels()) {
+	//avatars start in the middle of the board, as GameState's does:
+	avatar_x.assign(count, float(board_size.x / 2));
+	avatar_y.assign(count, float(board_size.y / 2));
+	velocity_x.assign(count, 0.0f);
+	velocity_y.assign(count, 0.0f);
+	push_x.assign(count, 0.0f);
+	push_y.assign(count, 0.0f);
+	counter_locations.resize(count * KeyCounters);
+	next_x.resize(count);
+	next_y.resize(count);
+	next_pickup.assign(count, 0);
+	num_sandwiches.assign(count, 0);
+	picked_up.assign(count, -1);
+
+	random.reserve(count);
+	for (uint32_t b = 0; b < count; ++b) {
+		random.emplace_back(seed, b);
+		generate_level(b);
+		cache_next(b);
+	}
+}
+
+void BatchSim::step(float elapsed, ThreadPool &pool) {
+	pool.parallel_for(count, STEP_GRAIN, [this, elapsed](uint32_t begin, uint32_t end) {
+		step_range(begin, end, elapsed);
+	});
+}
+
+void BatchSim::step_range(uint32_t begin, uint32_t end, float elapsed) {
+	//same order as GameState::update -- progress, then movement:
+	for (uint32_t b = begin; b < end; b += PICKUP_BLOCK) {
+		uint32_t n = std::min(end - b, uint32_t(PICKUP_BLOCK));
+		uint8_t hit[PICKUP_BLOCK];
+		kernels->adjacent(&next_x[b], &next_y[b], &avatar_x[b], &avatar_y[b], n, PickupLeeway, hit);
+		for (uint32_t i = 0; i < n; ++i) {
+			picked_up[b + i] = -1;
+			if (hit[i]) pickup(b + i);
+		}
+	}
+	kernels->step_avatar_axes(&avatar_x[begin], &velocity_x[begin], &push_x[begin], end - begin, elapsed, board_size.x);
+	kernels->step_avatar_axes(&avatar_y[begin], &velocity_y[begin], &push_y[begin], end - begin, elapsed, board_size.y);
+}
+
+uint64_t BatchSim::total_sandwiches() const {
+	return std::accumulate(num_sandwiches.begin(), num_sandwiches.end(), uint64_t(0));
+}
+
+void BatchSim::generate_level(uint32_t b) {
+	//same choice of layout as GameState::generate_level:
+	static thread_local OccupancyGrid scratch;
+	glm::vec2 avatar = glm::vec2(avatar_x[b], avatar_y[b]);
+	LevelLayout layout = generate_layout(board_size, random[b], &scratch);
+	for (uint32_t rejected = 0; rejected < MaxLayoutRejections && !layout_clear_of(layout, avatar); ++rejected) {
+		layout = generate_layout(board_size, random[b], &scratch);
+	}
+
+	for (uint32_t i = 0; i < KeyCounters; ++i) {
+		counter_locations[b * KeyCounters + i] = glm::uvec2(layout.locations[i].x, layout.locations[i].y);
+	}
+}
+
+void BatchSim::pickup(uint32_t b) {
+	picked_up[b] = int8_t(next_pickup[b]);
+
+	++next_pickup[b];
+	if (next_pickup[b] == ProgressionLength) {
+		++num_sandwiches[b];
+		next_pickup[b] = 0;
+		generate_level(b);
+	}
+	cache_next(b);
+}
+
+void BatchSim::cache_next(uint32_t b) {
+	glm::uvec2 next = counter_locations[b * KeyCounters + Progression[next_pickup[b]]];
+	next_x[b] = float(next.x);
+	next_y[b] = float(next.y);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "game_rules.hpp"
+#include "batch_kernels.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct ThreadPool; //ThreadPool.hpp
+
+// The 'BatchSim' struct steps many independent boards at once (e.g. for training or playtesting bots).
+// It follows the same rules as GameState (see game_rules.hpp), but stores the boards
+// structure-of-arrays, so each tick streams through flat arrays and boards split evenly across threads.
+// Boards are headless: there are no rotations or sounds, just the state the rules need.
+
+struct BatchSim {
+	//'seed' determines every board's sequence of levels 
+	// (board b draws from stream b of 'seed', so board 0 gets the levels GameState(seed) would):
+	BatchSim(uint32_t count, uint64_t seed, glm::uvec2 board_size = glm::uvec2(9,9));
+
+	//advance every board by 'elapsed' seconds, in parallel:
+	void step(float elapsed, ThreadPool &pool);
+
+	//advance boards [begin, end) by 'elapsed' seconds (thread-safe for disjoint ranges):
+	void step_range(uint32_t begin, uint32_t end, float elapsed);
+
+	uint32_t count;
+	glm::uvec2 board_size;
+
+	//inner loops used by step_range (best_batch_kernels() unless changed; every set gives identical results):
+	BatchKernels const *kernels;
+
+	//------- per-board state, indexed by board -------
+
+	//avatar (lower corner of its tile, as in GameState::avatar_location):
+	std::vector< float > avatar_x, avatar_y;
+	std::vector< float > velocity_x, velocity_y; //tiles per second
+
+	//controls, written by whoever is playing: -1, 0, or +1 along each axis (right and up are positive):
+	// (net pushes, so there's no coasting from holding both of an axis's keys, as a GameState player can)
+	std::vector< float > push_x, push_y;
+
+	//location of each board's KeyCounters counters, board-major (board * KeyCounters + counter):
+	std::vector< glm::uvec2 > counter_locations;
+
+	//location of each board's next pickup (cached from counter_locations for the adjacency test):
+	std::vector< float > next_x, next_y;
+
+	std::vector< uint8_t > next_pickup; //index into Progression
+	std::vector< uint32_t > num_sandwiches;
+
+	//set by step: the index into Progression picked up during that step, or -1 if none:
+	std::vector< int8_t > picked_up;
+
+	//per-board level generator (one stream per board):
+	std::vector< Pcg32 > random;
+
+	//sum of num_sandwiches over every board:
+	uint64_t total_sandwiches() const;
+
+private:
+	void generate_level(uint32_t board);
+	void pickup(uint32_t board);
+	void cache_next(uint32_t board); //next_x, next_y from next_pickup and counter_locations
+};
@@ -0,0 +1,122 @@
+#include "FramePacer.hpp"
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+bool FramePacer::parse_mode(std::string const &name, Mode *mode) {
+	for (Mode m : {Uncapped, Vsync, Adaptive, TargetFps}) {
+		if (name == mode_name(m)) {
+			*mode = m;
+			return true;
+		}
+	}
+	return false;
+}
+
+char const *FramePacer::mode_name(Mode mode) {
+	if (mode == Uncapped) return "uncapped";
+	if (mode == Vsync) return "vsync";
+	if (mode == Adaptive) return "adaptive";
+	return "fps";
+}
+
+FramePacer::FramePacer(Mode mode_, float target_fps_, float refresh_rate_) : mode(mode_), target_fps(target_fps_), refresh_rate(refresh_rate_) {
+	if (mode == Adaptive && SDL_GL_SetSwapInterval(-1) != 0) {
+		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << "); using plain vsync." << std::endl;
+		mode = Vsync;
+	}
+	if (mode == Vsync && SDL_GL_SetSwapInterval(1) != 0) {
+		std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << "); running uncapped." << std::endl;
+		mode = Uncapped;
+	}
+	if (mode == Uncapped || mode == TargetFps) {
+		SDL_GL_SetSwapInterval(0);
+	}
+	if (mode == TargetFps) {
+		period = std::chrono::duration_cast< Clock::duration >(std::chrono::duration< double >(1.0 / target_fps));
+	}
+}
+
+void FramePacer::wait() {
+	if (mode != TargetFps) return;
+
+	Clock::time_point now = Clock::now();
+	if (!started) {
+		started = true;
+		next_start = now;
+	}
+
+	if (now < next_start) {
+		//sleep through most of the wait, then spin through the rest (sleeps can overshoot by more than a frame's slack):
+		if (next_start - now > spin) {
+			Clock::time_point wake = next_start - spin;
+			std::this_thread::sleep_until(wake);
+			now = Clock::now();
+			if (now > next_start) {
+				++overslept;
+			}
+			sleep_overshot(now > wake ? now - wake : Clock::duration(0));
+		}
+		while (Clock::now() < next_start) {
+			std::this_thread::yield();
+		}
+	}
+
+	//frames are scheduled on a fixed grid, unless one ran so long it missed its slot entirely (then the grid restarts):
+	next_start += period;
+	now = Clock::now();
+	if (now > next_start) {
+		next_start = now;
+	}
+}
+
+void FramePacer::sleep_overshot(Clock::duration overshoot) {
+	//leave room for an overshoot this big (plus a little) right away; otherwise, ease back by 1/16th of the excess per frame:
+	Clock::duration needed = overshoot + std::chrono::duration_cast< Clock::duration >(std::chrono::microseconds(250));
+	if (needed > spin) {
+		spin = needed;
+	} else {
+		spin -= (spin - spin_baseline) / 16;
+	}
+	//(past a quarter of a frame, spinning costs more than the occasional late frame it would save)
+	spin = std::min(std::max(spin, spin_baseline), period / 4);
+}
+
+void FramePacer::presented() {
+	Clock::time_point now = Clock::now();
+	if (presented_once) {
+		float ms = std::chrono::duration< float, std::milli >(now - last_present).count();
+		intervals.add(ms);
+		interval_sum += ms;
+		interval_sum_squares += double(ms) * ms;
+
+		float expected = 0.0f;
+		if (mode == TargetFps) expected = 1000.0f / target_fps;
+		else if (mode != Uncapped && refresh_rate > 0.0f) expected = 1000.0f / refresh_rate;
+		if (expected > 0.0f && ms > 1.5f * expected) ++late;
+	}
+	presented_once = true;
+	last_present = now;
+}
+
+void FramePacer::report() const {
+	if (intervals.samples == 0) return;
+	double mean = interval_sum / intervals.samples;
+	double stddev = std::sqrt(std::max(0.0, interval_sum_squares / intervals.samples - mean * mean));
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Pacing (" << mode_name(mode);
+	if (mode == TargetFps) std::cout << " " << target_fps;
+	if (refresh_rate > 0.0f) std::cout << ", display " << refresh_rate << "Hz";
+	std::cout << "): " << (1000.0 / mean) << " fps over " << intervals.samples << " frames;"
+		<< " interval mean " << mean << "ms, jitter (stddev) " << stddev << "ms,"
+		<< " p50 " << intervals.percentile(0.5f) << "ms, p99 " << intervals.percentile(0.99f) << "ms, max " << intervals.max << "ms";
+	if (mode != Uncapped) std::cout << "; " << late << " late frames";
+	if (mode == TargetFps) std::cout << ", " << overslept << " oversleeps";
+	std::cout << std::defaultfloat << std::endl;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Profiler.hpp" //for Profiler::Histogram
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+//FramePacer decides when frames start and reports how evenly they end up being presented:
+//  Uncapped -- no vsync, no waiting (for GPU benchmarks and replays)
+//  Vsync -- swaps wait for vertical blank
+//  Adaptive -- vsync, but late frames swap immediately (tear) rather than waiting a whole extra refresh;
+//              falls back to Vsync where unsupported
+//  TargetFps -- no vsync; sleeps (then spins for the last moment) until each frame's start time, so a fixed
+//               rate below the display's costs no more CPU or GPU time than it has to
+// In every mode, the time between successive swaps is kept in a histogram and summarized by report().
+struct FramePacer {
+	typedef std::chrono::high_resolution_clock Clock;
+
+	enum Mode : uint32_t { Uncapped = 0, Vsync = 1, Adaptive = 2, TargetFps = 3 };
+
+	//parse a mode name ("uncapped", "vsync", "adaptive", or "fps"); returns false if 'name' is none of these:
+	static bool parse_mode(std::string const &name, Mode *mode);
+	static char const *mode_name(Mode mode);
+
+	//sets the swap interval for 'mode' on the current GL context (falling back to a mode that works), so create after the context;
+	// 'target_fps' is only used by TargetFps, and 'refresh_rate' (the display's, in Hz, or 0 if unknown) only for reporting:
+	FramePacer(Mode mode, float target_fps, float refresh_rate);
+
+	//call at the start of each frame, before input is read; in TargetFps mode, returns at the frame's start time:
+	void wait();
+
+	//call just after each swap:
+	void presented();
+
+	//print the achieved rate and frame-to-frame jitter:
+	void report() const;
+
+	Mode mode;
+	float target_fps = 0.0f;
+	float refresh_rate = 0.0f;
+
+	//------- internals -------
+
+	Clock::duration period = Clock::duration(0); //between frame starts, in TargetFps mode
+	Clock::time_point next_start;
+	bool started = false;
+
+	//sleeps wake up late by up to the OS's timer slack, so wait() sleeps until this long before the deadline, then spins;
+	// raised to cover any sleep that overshoots by more, then decayed back toward spin_baseline (and never more than a quarter frame),
+	// so one hiccup doesn't leave every later frame spinning:
+	Clock::duration spin_baseline = std::chrono::microseconds(1000);
+	Clock::duration spin = spin_baseline;
+	//update 'spin' after a sleep that woke 'overshoot' after it was asked to:
+	void sleep_overshot(Clock::duration overshoot);
+
+	Clock::time_point last_present;
+	bool presented_once = false;
+	Profiler::Histogram intervals; //ms between swaps
+	double interval_sum = 0.0; //ms
+	double interval_sum_squares = 0.0; //ms^2
+	uint64_t late = 0; //intervals more than 1.5x the expected frame time
+	uint64_t overslept = 0; //TargetFps frames that started late because a sleep overshot
+};
@@ -1,373 +1,739 @@
 #include "Game.hpp"
 
+#include "HudText.hpp" //one-draw text baked from glyph meshes
+#include "Profiler.hpp" //GPU pass timers
+#include "Metrics.hpp" //gameplay counters for fleet telemetry
+#include "StreamBuffer.hpp" //fenced ring buffer for per-frame data
+#include "ShaderCache.hpp" //programs built from shader files, with cached binaries
+#include "TextureAtlas.hpp" //every mesh texture in one compressed, mipmapped texture
 #include "gl_errors.hpp" //helper for dumping OpenGL error messages
-#include "read_chunk.hpp" //helper for reading a vector of structures from a file
+#include "mapped_file.hpp" //helper for using chunks of a memory-mapped file in-place
+#include "name_index.hpp" //hash table from names (in a character buffer) to values
+#include "mixer.hpp" //mixes sounds into a single, persistent audio device
 #include "data_path.hpp" //helper to get paths relative to executable
 
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <SDL_audio.h>
+#include <SDL_audio.h> //for SDL_MIX_MAXVOLUME
 
 #include <iostream>
 #include <fstream>
 #include <set>
-#include <map>
 #include <cstddef>
-#include <random>
-
-#define BUFFER_SIZE 512
-#define AUDIO_VOLUME 10
-
-//helper defined later; throws if shader compilation fails:
+#include <cassert>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#define AUDIO_VOLUME (10.0f / SDL_MIX_MAXVOLUME) //same level the notes had through SDL_MixAudio
+
+//GLSL declaration of the per-frame uniform block; layout must match Game::FrameUniforms:
+#define FRAME_BLOCK_GLSL \
+	"layout(std140) uniform Frame {\n" \
+	"	mat4 world_to_clip;\n" \
+	"	mat4 model_scale;\n" \
+	"	vec4 sun_direction;\n" \
+	"	vec4 sun_color;\n" \
+	"	vec4 sky_direction;\n" \
+	"	vec4 sky_color;\n" \
+	"};\n"
+
+//helpers defined later (transforms, camera fitting, instanced drawing, and vertex unpacking):
 static glm::mat4 location_v3m4(glm::vec3 v, glm::quat r);
-static GLuint compile_shader(GLenum type, std::string const &source);
-static bool adjacent(glm::vec3 locationA, glm::vec3 locationB, float leeway);
-static void audio_callback(void *userdata, Uint8 *stream, int len);
-
-uint8_t *current_audio_pos;
-uint32_t current_audio_len;
-
-Game::Game() {
-	{ //create an opengl program to perform sun/sky (well, directional+hemispherical) lighting:
-		GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER,
-			"#version 330\n"
-			"uniform mat4 object_to_clip;\n"
-            "uniform mat4 model_scale;\n"
-			"uniform mat4x3 object_to_light;\n"
-			"uniform mat3 normal_to_light;\n"
-			"layout(location=0) in vec4 Position;\n" //note: layout keyword used to make sure that the location-0 attribute is always bound to something
-			"in vec3 Normal;\n"
-			"in vec4 Color;\n"
-			"out vec3 position;\n"
-			"out vec3 normal;\n"
-			"out vec4 color;\n"
-			"void main() {\n"
-			"	gl_Position = object_to_clip * model_scale * Position;\n"
-			"	position = object_to_light * Position;\n"
-			"	normal = normal_to_light * Normal;\n"
-			"	color = Color;\n"
-			"}\n"
-		);
-
-		GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER,
-			"#version 330\n"
-			"uniform vec3 sun_direction;\n"
-			"uniform vec3 sun_color;\n"
-			"uniform vec3 sky_direction;\n"
-			"uniform vec3 sky_color;\n"
-			"in vec3 position;\n"
-			"in vec3 normal;\n"
-			"in vec4 color;\n"
-			"out vec4 fragColor;\n"
-			"void main() {\n"
-			"	vec3 total_light = vec3(0.0, 0.0, 0.0);\n"
-			"	vec3 n = normalize(normal);\n"
-			"	{ //sky (hemisphere) light:\n"
-			"		vec3 l = sky_direction;\n"
-			"		float nl = 0.5 + 0.5 * dot(n,l);\n"
-			"		total_light += nl * sky_color;\n"
-			"	}\n"
-			"	{ //sun (directional) light:\n"
-			"		vec3 l = sun_direction;\n"
-			"		float nl = max(0.0, dot(n,l));\n"
-			"		total_light += nl * sun_color;\n"
-			"	}\n"
-			"	fragColor = vec4(color.rgb * total_light, color.a);\n"
-			"}\n"
-		);
-
-		simple_shading.program = glCreateProgram();
-		glAttachShader(simple_shading.program, vertex_shader);
-		glAttachShader(simple_shading.program, fragment_shader);
-		//shaders are reference counted so this makes sure they are freed after program is deleted:
-		glDeleteShader(vertex_shader);
-		glDeleteShader(fragment_shader);
-
-		//link the shader program and throw errors if linking fails:
-		glLinkProgram(simple_shading.program);
-		GLint link_status = GL_FALSE;
-		glGetProgramiv(simple_shading.program, GL_LINK_STATUS, &link_status);
-		if (link_status != GL_TRUE) {
-			std::cerr << "Failed to link shader program." << std::endl;
-			GLint info_log_length = 0;
-			glGetProgramiv(simple_shading.program, GL_INFO_LOG_LENGTH, &info_log_length);
-			std::vector< GLchar > info_log(info_log_length, 0);
-			GLsizei length = 0;
-			glGetProgramInfoLog(simple_shading.program, GLsizei(info_log.size()), &length, &info_log[0]);
-			std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
-			throw std::runtime_error("failed to link program");
-		}
+static float fit_scale(glm::vec2 extent, float aspect);
+static glm::mat4 view_to_clip(glm::vec2 center, float scale, float aspect);
+static void point_instance_attribute(GLuint location, GLsizei first_instance);
+static void draw_mesh_instances(Game::Mesh const &mesh, GLsizei instance_count);
+static float half_to_float(uint16_t h);
+static glm::vec3 unpack_normal(uint32_t n);
+
+//vertex layout of 'dat0' blobs (unindexed triangles; still loaded, for blobs not yet re-encoded by export-meshes.py --from-dat0):
+struct Vertex {
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::u8vec4 Color;
+};
+static_assert(sizeof(Vertex) == 28, "Vertex should be packed.");
+
+//vertex layout of 'dat1' blobs (deduplicated, quantized, and drawn through 'ind1' indices):
+struct PackedVertex {
+	glm::u16vec4 Position; //half floats (w is 1.0)
+	uint32_t Normal; //signed normalized 2_10_10_10, x in the low bits
+	glm::u8vec4 Color;
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex should be packed.");
+
+//vertex layout of 'dat2' blobs (as 'dat1', plus coordinates in the texture atlas):
+struct TexturedVertex {
+	PackedVertex packed;
+	glm::u16vec2 TexCoord; //unsigned normalized
+};
+static_assert(sizeof(TexturedVertex) == 20, "TexturedVertex should be packed.");
+
+//levels of the texture atlas to use (pack-atlas.py's 16-pixel gutters keep textures from bleeding together for this many):
+static constexpr uint32_t AtlasMipLevels = 5;
+
+//mesh data, mapped and checked on a worker thread; uploaded by Game::finish_loading:
+struct Game::MeshAssets {
+	MeshAssets(); //throws on failure
+
+	//the blob is mapped rather than read, so chunk data is used in-place without a heap copy:
+	MappedFile blob;
+	bool indexed = false; //'dat1' or 'dat2' (packed_vertices or textured_vertices, + triangle_indices) rather than 'dat0' (vertices)
+	bool textured = false; //'dat2'
+	ChunkView< Vertex > vertices;
+	ChunkView< PackedVertex > packed_vertices;
+	ChunkView< TexturedVertex > textured_vertices;
+	std::unique_ptr< TextureAtlas::Image > atlas; //decoded and mipmapped here, too (only for 'dat2' blobs)
+	ChunkView< uint16_t > triangle_indices;
+
+	Mesh avatar_mesh;
+	Mesh counter_mesh;
+	Mesh tile_mesh;
+	Mesh peanut_mesh; Mesh peanut_gray;
+	Mesh bread_mesh; Mesh bread_gray;
+	Mesh jelly_mesh; Mesh jelly_gray;
+	Mesh serve_mesh; Mesh serve_gray;
+
+	std::vector< HudText::Vertex > sandwiches_made;
+	std::vector< HudText::Vertex > digits[10];
+};
+
+//the sound bank, mapped and checked on a worker thread:
+struct Game::SoundAssets {
+	SoundAssets(); //throws on failure
+
+	//notes are stored pre-converted to the mixer's format (see sounds/pack-sounds.py),
+	// so they are played straight out of the mapped file:
+	std::unique_ptr< MappedFile > bank;
+
+	Sound d0;
+	Sound re;
+	Sound mi;
+	Sound fa;
+	Sound so;
+};
+
+Game::Game(uint64_t seed) : state(seed) {
+	//assets are mapped and checked on worker threads while the shaders compile (and while the first frames are drawn);
+	// finish_loading then uploads each to the GPU from this, the GL, thread:
+	mesh_assets = std::async(std::launch::async, []() {
+		return std::unique_ptr< MeshAssets >(new MeshAssets());
+	});
+	sound_assets = std::async(std::launch::async, []() {
+		return std::unique_ptr< SoundAssets >(new SoundAssets());
+	});
+
+	{ //build (or load from the shader cache) the sun/sky (well, directional+hemispherical) lighting programs:
+		shaders.reset(new ShaderCache(data_path("shaders.cache")));
+
+		//attributes are bound to fixed locations, so vertex arrays stay valid when programs are reloaded:
+		ShaderCache::Attributes attributes = {
+			{"Position", 0}, {"Normal", 1}, {"Color", 2},
+			{"Object_to_world", 3}, //per-instance; occupies locations 3-6
+			{"TexCoord", 7},
+		};
+		//the programs only sample the atlas if the meshes have texture coordinates for it
+		// (the blob is checked here, rather than waiting for it to load, so the programs can compile meanwhile):
+		textured = next_chunk_is(MappedFile(data_path("pbj_meshes.blob")), 0, "dat2");
+		std::string prelude = std::string("#version 330\n") + (textured ? "#define TEXTURED 1\n" : "#define TEXTURED 0\n") + FRAME_BLOCK_GLSL;
+		simple_shading_index = shaders->add(prelude, data_path("shaders/lit.vert"), data_path("shaders/lit.frag"), attributes);
+		instanced_shading_index = shaders->add(prelude, data_path("shaders/lit_instanced.vert"), data_path("shaders/lit.frag"), attributes);
+		shaders->save();
+
+		setup_programs();
 	}
 
-	{ //read back uniform and attribute locations from the shader program:
-		simple_shading.object_to_clip_mat4 = glGetUniformLocation(simple_shading.program, "object_to_clip");
-		simple_shading.model_scale_mat4 = glGetUniformLocation(simple_shading.program, "model_scale");
-		simple_shading.object_to_light_mat4x3 = glGetUniformLocation(simple_shading.program, "object_to_light");
-		simple_shading.normal_to_light_mat3 = glGetUniformLocation(simple_shading.program, "normal_to_light");
-
-		simple_shading.sun_direction_vec3 = glGetUniformLocation(simple_shading.program, "sun_direction");
-		simple_shading.sun_color_vec3 = glGetUniformLocation(simple_shading.program, "sun_color");
-		simple_shading.sky_direction_vec3 = glGetUniformLocation(simple_shading.program, "sky_direction");
-		simple_shading.sky_color_vec3 = glGetUniformLocation(simple_shading.program, "sky_color");
+	{ //per-frame storage for the programs' Frame blocks:
+		//one copy of the block per pass per frame, each starting on an offset the driver accepts for glBindBufferRange:
+		GLint alignment = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		alignment = std::max(alignment, GLint(1));
+		GLsizeiptr stride = ((GLsizeiptr(sizeof(FrameUniforms)) + alignment - 1) / alignment) * alignment;
+		frame_stream.reset(new StreamBuffer(GL_UNIFORM_BUFFER, stride * FramePasses, alignment));
+	}
 
-		simple_shading.Position_vec4 = glGetAttribLocation(simple_shading.program, "Position");
-		simple_shading.Normal_vec3 = glGetAttribLocation(simple_shading.program, "Normal");
-		simple_shading.Color_vec4 = glGetAttribLocation(simple_shading.program, "Color");
+	// Sounds from https://freesound.org/people/morgantj/sounds/58634/
+	//the audio device is opened once here; notes are mixed into it as they are picked up (once the bank is loaded):
+	mixer_init();
+	notes = {&d0, &re, &mi, &fa, &so};
+
+	//upcoming levels are generated in the background, so finishing a sandwich doesn't stall a frame:
+	state.use_level_pool();
+
+	{ // Match key counters with their meshes
+		key_counter_meshes = {
+			{&peanut_mesh, &peanut_gray},
+			{&bread_mesh, &bread_gray},
+			{&jelly_mesh, &jelly_gray},
+			{&serve_mesh, &serve_gray},
+		};
+		assert(key_counter_meshes.size() == state.key_counters.size());
+		assert(notes.size() == state.level_progression.size());
 	}
+}
 
-	struct Vertex {
-		glm::vec3 Position;
-		glm::vec3 Normal;
-		glm::u8vec4 Color;
-	};
-	static_assert(sizeof(Vertex) == 28, "Vertex should be packed.");
+Game::MeshAssets::MeshAssets() : blob(data_path("pbj_meshes.blob")) {
+	size_t offset = 0;
+	//The blob will be made up of three (or four) chunks:
+	// the first chunk will be vertex data (interleaved position/normal/color)
+	// the second chunk will be characters
+	// (for 'dat1' blobs, a chunk of 16-bit triangle indices, relative to the first vertex of each mesh)
+	// the last chunk will be an index, mapping a name (range of characters) to a mesh (range of vertex data [and indices])
+	textured = next_chunk_is(blob, offset, "dat2");
+	indexed = textured || next_chunk_is(blob, offset, "dat1");
+
+	//read vertex data:
+	size_t vertex_count = 0;
+	if (textured) {
+		map_chunk(blob, &offset, "dat2", &textured_vertices);
+		vertex_count = textured_vertices.size;
+	} else if (indexed) {
+		map_chunk(blob, &offset, "dat1", &packed_vertices);
+		vertex_count = packed_vertices.size;
+	} else {
+		map_chunk(blob, &offset, "dat0", &vertices);
+		vertex_count = vertices.size;
+	}
 
-	{ //load mesh data from a binary blob:
-		std::ifstream blob(data_path("pbj_meshes.blob"), std::ios::binary);
-		//The blob will be made up of three chunks:
-		// the first chunk will be vertex data (interleaved position/normal/color)
-		// the second chunk will be characters
-		// the third chunk will be an index, mapping a name (range of characters) to a mesh (range of vertex data)
+	//read character data (for names):
+	ChunkView< char > names;
+	map_chunk(blob, &offset, "str0", &names);
 
-		//read vertex data:
-		std::vector< Vertex > vertices;
-		read_chunk(blob, "dat0", &vertices);
+	//read triangle indices:
+	if (indexed) {
+		map_chunk(blob, &offset, "ind1", &triangle_indices);
+	}
 
-		//read character data (for names):
-		std::vector< char > names;
-		read_chunk(blob, "str0", &names);
+	//hash index of names (as ranges into the mapped 'str0' chunk) to meshes:
+	NameIndex< Mesh > index(names.data, names.size, 0);
+	auto add_mesh = [&](uint32_t name_begin, uint32_t name_end, Mesh const &mesh) {
+		if (name_begin > name_end || name_end > names.size) {
+			throw std::runtime_error("invalid name indices in index.");
+		}
+		if (!index.insert(name_begin, name_end, mesh)) {
+			throw std::runtime_error("duplicate name in index.");
+		}
+	};
 
-		//read index:
+	//read index:
+	if (indexed) {
 		struct IndexEntry {
 			uint32_t name_begin;
 			uint32_t name_end;
 			uint32_t vertex_begin;
 			uint32_t vertex_end;
+			uint32_t index_begin;
+			uint32_t index_end;
 		};
-		static_assert(sizeof(IndexEntry) == 16, "IndexEntry should be packed.");
+		static_assert(sizeof(IndexEntry) == 24, "IndexEntry should be packed.");
 
-		std::vector< IndexEntry > index_entries;
-		read_chunk(blob, "idx0", &index_entries);
+		ChunkView< IndexEntry > index_entries;
+		map_chunk(blob, &offset, "idx1", &index_entries);
 
-		if (blob.peek() != EOF) {
-			std::cerr << "WARNING: trailing data in meshes file." << std::endl;
+		for (IndexEntry const &e : index_entries) {
+			if (e.vertex_begin > e.vertex_end || e.vertex_end > vertex_count) {
+				throw std::runtime_error("invalid vertex indices in index.");
+			}
+			if (e.index_begin > e.index_end || e.index_end > triangle_indices.size) {
+				throw std::runtime_error("invalid triangle indices in index.");
+			}
+			for (uint32_t i = e.index_begin; i < e.index_end; ++i) {
+				if (triangle_indices[i] >= e.vertex_end - e.vertex_begin) {
+					throw std::runtime_error("triangle index outside of its mesh.");
+				}
+			}
+			Mesh mesh;
+			mesh.first = e.vertex_begin;
+			mesh.count = e.vertex_end - e.vertex_begin;
+			mesh.index_first = e.index_begin;
+			mesh.index_count = e.index_end - e.index_begin;
+			add_mesh(e.name_begin, e.name_end, mesh);
 		}
+	} else {
+		struct IndexEntry {
+			uint32_t name_begin;
+			uint32_t name_end;
+			uint32_t vertex_begin;
+			uint32_t vertex_end;
+		};
+		static_assert(sizeof(IndexEntry) == 16, "IndexEntry should be packed.");
 
-		//upload vertex data to the graphics card:
-		glGenBuffers(1, &meshes_vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, meshes_vbo);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		ChunkView< IndexEntry > index_entries;
+		map_chunk(blob, &offset, "idx0", &index_entries);
 
-		//create map to store index entries:
-		std::map< std::string, Mesh > index;
 		for (IndexEntry const &e : index_entries) {
-			if (e.name_begin > e.name_end || e.name_end > names.size()) {
-				throw std::runtime_error("invalid name indices in index.");
-			}
-			if (e.vertex_begin > e.vertex_end || e.vertex_end > vertices.size()) {
+			if (e.vertex_begin > e.vertex_end || e.vertex_end > vertex_count) {
 				throw std::runtime_error("invalid vertex indices in index.");
 			}
 			Mesh mesh;
 			mesh.first = e.vertex_begin;
 			mesh.count = e.vertex_end - e.vertex_begin;
-			auto ret = index.insert(std::make_pair(
-				std::string(names.begin() + e.name_begin, names.begin() + e.name_end),
-				mesh));
-			if (!ret.second) {
-				throw std::runtime_error("duplicate name in index.");
-			}
+			add_mesh(e.name_begin, e.name_end, mesh);
 		}
+	}
 
-		//look up into index map to extract meshes:
-		auto lookup = [&index](std::string const &name) -> Mesh {
-			auto f = index.find(name);
-			if (f == index.end()) {
-				throw std::runtime_error("Mesh named '" + name + "' does not appear in index.");
-			}
-			return f->second;
-		};
+	if (offset != blob.size) {
+		std::cerr << "WARNING: trailing data in meshes file." << std::endl;
+	}
 
-		avatar_mesh = lookup("Avatar");
-		counter_mesh = lookup("Counter");
-		tile_mesh = lookup("Tile");
-		peanut_mesh = lookup("Peanut"); peanut_gray = lookup("Peanut_Gray");
-		bread_mesh = lookup("Bread"); bread_gray = lookup("Bread_Gray");
-		jelly_mesh = lookup("Jelly"); jelly_gray = lookup("Jelly_Gray");
-		serve_mesh = lookup("Serve"); serve_gray = lookup("Serve_Gray");
-
-		//text meshes
-		sandwiches_made = lookup("sandwiches made");
-		num0 = lookup("0");
-		num1 = lookup("1");
-		num2 = lookup("2");
-		num3 = lookup("3");
-		num4 = lookup("4");
-		num5 = lookup("5");
-		num6 = lookup("6");
-		num7 = lookup("7");
-		num8 = lookup("8");
-		num9 = lookup("9");
-		digits = {&num0, &num1, &num2, &num3, &num4, &num5, &num6, &num7, &num8, &num9};
+	//look up into index to extract meshes (keys are hashed at compile time):
+	auto lookup = [&index](NameKey const &key) -> Mesh {
+		Mesh const *found = index.find(key);
+		if (!found) {
+			throw std::runtime_error("Mesh named '" + std::string(key.name, key.length) + "' does not appear in index.");
+		}
+		return *found;
 	};
 
-	{ //create vertex array object to hold the map from the mesh vertex buffer to shader program attributes:
-		glGenVertexArrays(1, &meshes_for_simple_shading_vao);
-		glBindVertexArray(meshes_for_simple_shading_vao);
-		glBindBuffer(GL_ARRAY_BUFFER, meshes_vbo);
-		//note that I'm specifying a 3-vector for a 4-vector attribute here, and this is okay to do:
-		// Do this for position, normal, and color vertex attributes
-		glVertexAttribPointer(simple_shading.Position_vec4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, Position));
-		glEnableVertexAttribArray(simple_shading.Position_vec4);
-		if (simple_shading.Normal_vec3 != -1U) {
-			glVertexAttribPointer(simple_shading.Normal_vec3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, Normal));
-			glEnableVertexAttribArray(simple_shading.Normal_vec3);
-		}
-		if (simple_shading.Color_vec4 != -1U) {
-			glVertexAttribPointer(simple_shading.Color_vec4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, Color));
-			glEnableVertexAttribArray(simple_shading.Color_vec4);
+	avatar_mesh = lookup("Avatar"_name);
+	counter_mesh = lookup("Counter"_name);
+	tile_mesh = lookup("Tile"_name);
+	peanut_mesh = lookup("Peanut"_name); peanut_gray = lookup("Peanut_Gray"_name);
+	bread_mesh = lookup("Bread"_name); bread_gray = lookup("Bread_Gray"_name);
+	jelly_mesh = lookup("Jelly"_name); jelly_gray = lookup("Jelly_Gray"_name);
+	serve_mesh = lookup("Serve"_name); serve_gray = lookup("Serve_Gray"_name);
+
+	//text is drawn from CPU copies of the glyph meshes (see HudText):
+	auto glyph_vertices = [&](Mesh const &mesh) {
+		std::vector< HudText::Vertex > glyph;
+		if (indexed) {
+			glyph.reserve(mesh.index_count);
+			for (GLsizei i = 0; i < mesh.index_count; ++i) {
+				uint32_t vertex = mesh.first + triangle_indices[mesh.index_first + i];
+				PackedVertex const &p = (textured ? textured_vertices[vertex].packed : packed_vertices[vertex]);
+				HudText::Vertex v;
+				v.Position = glm::vec3(half_to_float(p.Position.x), half_to_float(p.Position.y), half_to_float(p.Position.z));
+				v.Normal = unpack_normal(p.Normal);
+				v.Color = p.Color;
+				glyph.emplace_back(v);
+			}
+		} else {
+			glyph.reserve(mesh.count);
+			for (GLsizei i = 0; i < mesh.count; ++i) {
+				Vertex const &p = vertices[mesh.first + i];
+				HudText::Vertex v;
+				v.Position = p.Position;
+				v.Normal = p.Normal;
+				v.Color = p.Color;
+				glyph.emplace_back(v);
+			}
 		}
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return glyph;
+	};
+
+	sandwiches_made = glyph_vertices(lookup("sandwiches made"_name));
+	digits[0] = glyph_vertices(lookup("0"_name));
+	digits[1] = glyph_vertices(lookup("1"_name));
+	digits[2] = glyph_vertices(lookup("2"_name));
+	digits[3] = glyph_vertices(lookup("3"_name));
+	digits[4] = glyph_vertices(lookup("4"_name));
+	digits[5] = glyph_vertices(lookup("5"_name));
+	digits[6] = glyph_vertices(lookup("6"_name));
+	digits[7] = glyph_vertices(lookup("7"_name));
+	digits[8] = glyph_vertices(lookup("8"_name));
+	digits[9] = glyph_vertices(lookup("9"_name));
+
+	//textured meshes sample the atlas packed along with them (see meshes/Makefile):
+	if (textured) {
+		atlas.reset(new TextureAtlas::Image(data_path("pbj_atlas.png"), AtlasMipLevels));
 	}
+}
 
-	GL_ERRORS();
+Game::SoundAssets::SoundAssets() : bank(new MappedFile(data_path("notes.blob"))) {
+	size_t offset = 0;
 
-	// NOTE: based on code from https://gist.github.com/armornick/3447121
-	// Sounds from https://freesound.org/people/morgantj/sounds/58634/
-	{ // Set up sound
-		d0.wav_buffer = new uint8_t [BUFFER_SIZE];
-		re.wav_buffer = new uint8_t [BUFFER_SIZE];
-		mi.wav_buffer = new uint8_t [BUFFER_SIZE];
-		fa.wav_buffer = new uint8_t [BUFFER_SIZE];
-		so.wav_buffer = new uint8_t [BUFFER_SIZE];
-
-		if (SDL_Init(SDL_INIT_AUDIO) < 0) {
-			throw std::runtime_error("failed to init audio");
-		}
+	ChunkView< int16_t > samples;
+	map_chunk(*bank, &offset, "pcm0", &samples);
 
-		//TODO: ????????
-		if( SDL_LoadWAV("sounds/do (actually fa).wav", &d0.wav_spec, &d0.wav_buffer, &d0.wav_length) == NULL ){
-			throw std::runtime_error("failed to load audio");
-		}
-		if( SDL_LoadWAV("sounds/re.wav", &re.wav_spec, &re.wav_buffer, &re.wav_length) == NULL ){
-			throw std::runtime_error("failed to load audio");
+	ChunkView< char > names;
+	map_chunk(*bank, &offset, "str0", &names);
+
+	struct IndexEntry {
+		uint32_t name_begin;
+		uint32_t name_end;
+		uint32_t frame_begin;
+		uint32_t frame_end;
+	};
+	static_assert(sizeof(IndexEntry) == 16, "IndexEntry should be packed.");
+
+	ChunkView< IndexEntry > index_entries;
+	map_chunk(*bank, &offset, "snd0", &index_entries);
+
+	if (offset != bank->size) {
+		std::cerr << "WARNING: trailing data in sound bank." << std::endl;
+	}
+
+	NameIndex< Sound > index(names.data, names.size, index_entries.size);
+	for (IndexEntry const &e : index_entries) {
+		if (e.name_begin > e.name_end || e.name_end > names.size) {
+			throw std::runtime_error("invalid name indices in sound bank.");
 		}
-		if( SDL_LoadWAV("sounds/mi.wav", &mi.wav_spec, &mi.wav_buffer, &mi.wav_length) == NULL ){
-			throw std::runtime_error("failed to load audio");
+		if (e.frame_begin > e.frame_end || e.frame_end > samples.size / MIXER_CHANNELS) {
+			throw std::runtime_error("invalid frame indices in sound bank.");
 		}
-		if( SDL_LoadWAV("sounds/fa (actually do).wav", &fa.wav_spec, &d0.wav_buffer, &fa.wav_length) == NULL ){
-			throw std::runtime_error("failed to load audio");
+		Sound sound;
+		sound.samples = samples.data + e.frame_begin * MIXER_CHANNELS;
+		sound.frames = e.frame_end - e.frame_begin;
+		if (!index.insert(e.name_begin, e.name_end, sound)) {
+			throw std::runtime_error("duplicate name in sound bank.");
 		}
-		if( SDL_LoadWAV("sounds/so.wav", &so.wav_spec, &so.wav_buffer, &so.wav_length) == NULL ){
-			throw std::runtime_error("failed to load audio");
+	}
+
+	auto lookup = [&index](NameKey const &key) -> Sound {
+		Sound const *found = index.find(key);
+		if (!found) {
+			throw std::runtime_error("Sound named '" + std::string(key.name, key.length) + "' does not appear in sound bank.");
 		}
+		return *found;
+	};
 
-		d0.wav_spec.callback = audio_callback;
-		re.wav_spec.callback = audio_callback;
-		mi.wav_spec.callback = audio_callback;
-		fa.wav_spec.callback = audio_callback;
-		so.wav_spec.callback = audio_callback;
+	d0 = lookup("do"_name);
+	re = lookup("re"_name);
+	mi = lookup("mi"_name);
+	fa = lookup("fa"_name);
+	so = lookup("so"_name);
+}
 
-		d0.wav_spec.userdata = NULL;
-		re.wav_spec.userdata = NULL;
-		mi.wav_spec.userdata = NULL;
-		fa.wav_spec.userdata = NULL;
-		so.wav_spec.userdata = NULL;
+//true if an asset can be taken from 'future' without waiting:
+template< typename T >
+static bool is_ready(std::future< T > const &future) {
+	return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
 
-		notes = {&d0, &re, &mi, &fa, &so};
+void Game::finish_loading() {
+	//take whatever has finished loading (get() rethrows here anything a worker threw):
+	if (is_ready(mesh_assets)) {
+		upload_meshes(*mesh_assets.get());
+		meshes_loaded = true;
+	}
+
+	if (is_ready(sound_assets)) {
+		std::unique_ptr< SoundAssets > sounds = sound_assets.get();
+		sound_bank = std::move(sounds->bank);
+		d0 = sounds->d0;
+		re = sounds->re;
+		mi = sounds->mi;
+		fa = sounds->fa;
+		so = sounds->so;
+		sounds_loaded = true;
+	}
+
+	loaded = meshes_loaded && sounds_loaded;
+}
+
+void Game::upload_meshes(MeshAssets const &assets) {
+	if (assets.textured != textured) {
+		throw std::runtime_error("mesh blob changed format while loading.");
+	}
+
+	//how meshes_vbo is laid out, for connecting it to program attributes below:
+	struct AttribFormat {
+		GLint size;
+		GLenum type;
+		GLboolean normalized;
+		size_t offset;
 	};
+	AttribFormat position_format{}, normal_format{}, color_format{}, texcoord_format{};
+	GLsizei vertex_stride = 0;
+
+	//upload vertex (and index) data to the graphics card straight from the mapping:
+	glGenBuffers(1, &meshes_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, meshes_vbo);
+	if (assets.textured) {
+		glBufferData(GL_ARRAY_BUFFER, sizeof(TexturedVertex) * assets.textured_vertices.size, assets.textured_vertices.data, GL_STATIC_DRAW);
+		//(the packed attributes are at the start of each vertex, so their offsets are the same as in PackedVertex)
+		position_format = AttribFormat{4, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, Position)};
+		normal_format = AttribFormat{4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertex, Normal)};
+		color_format = AttribFormat{4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(PackedVertex, Color)};
+		texcoord_format = AttribFormat{2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(TexturedVertex, TexCoord)};
+		vertex_stride = sizeof(TexturedVertex);
+	} else if (assets.indexed) {
+		glBufferData(GL_ARRAY_BUFFER, sizeof(PackedVertex) * assets.packed_vertices.size, assets.packed_vertices.data, GL_STATIC_DRAW);
+		//note: GL 3.3 defines signed normalized 2_10_10_10 conversion as (2c+1)/1023, which is off from the exporter's c/511 by well under 1%
+		position_format = AttribFormat{4, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, Position)};
+		normal_format = AttribFormat{4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertex, Normal)};
+		color_format = AttribFormat{4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(PackedVertex, Color)};
+		vertex_stride = sizeof(PackedVertex);
+	} else {
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * assets.vertices.size, assets.vertices.data, GL_STATIC_DRAW);
+		//note that I'm specifying a 3-vector for a 4-vector attribute here, and this is okay to do:
+		position_format = AttribFormat{3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position)};
+		normal_format = AttribFormat{3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal)};
+		color_format = AttribFormat{4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Vertex, Color)};
+		vertex_stride = sizeof(Vertex);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	{ // Set up game state and level
-		left.is_row = 0; 		left.is_end = 0;
-		top.is_end = 0;			top.is_row = 1;
-		right.is_row = 0;		right.is_end = 1;
-		bottom.is_end = 1;		bottom.is_row = 1;
+	if (assets.indexed) {
+		glGenBuffers(1, &meshes_ibo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshes_ibo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * assets.triangle_indices.size, assets.triangle_indices.data, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
 
-		edges = {&top, &bottom, &left, &right};
+	//connect meshes_vbo (and meshes_ibo, if present) to a program's per-vertex attributes in the currently bound vertex array object:
+	auto bind_mesh_attributes = [&](GLuint Position_vec4, GLuint Normal_vec3, GLuint Color_vec4, GLuint TexCoord_vec2) {
+		auto bind = [&](GLuint location, AttribFormat const &format) {
+			glVertexAttribPointer(location, format.size, format.type, format.normalized, vertex_stride, (GLbyte *)0 + format.offset);
+			glEnableVertexAttribArray(location);
+		};
+		glBindBuffer(GL_ARRAY_BUFFER, meshes_vbo);
+		bind(Position_vec4, position_format);
+		if (Normal_vec3 != -1U) bind(Normal_vec3, normal_format);
+		if (Color_vec4 != -1U) bind(Color_vec4, color_format);
+		if (TexCoord_vec2 != -1U && assets.textured) bind(TexCoord_vec2, texcoord_format);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		//the element array binding is part of vertex array object state:
+		if (meshes_ibo != -1U) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshes_ibo);
+	};
 
-		peanut.active = &peanut_mesh;	peanut.inactive = &peanut_gray;
-		bread.active = &bread_mesh;		bread.inactive = &bread_gray;
-		jelly.active = &jelly_mesh;		jelly.inactive = &jelly_gray;
-		serve.active = &serve_mesh;		serve.inactive = &serve_gray;
+	{ //create vertex array object to hold the map from the mesh vertex buffer to shader program attributes:
+		glGenVertexArrays(1, &meshes_for_simple_shading_vao);
+		glBindVertexArray(meshes_for_simple_shading_vao);
+		bind_mesh_attributes(simple_shading.Position_vec4, simple_shading.Normal_vec3, simple_shading.Color_vec4, simple_shading.TexCoord_vec2);
+
+		//same per-vertex data for the instanced program, plus per-instance transforms:
+		glGenBuffers(1, &instances_vbo);
+		glGenBuffers(1, &counter_instances_vbo);
+
+		glGenVertexArrays(1, &meshes_for_instanced_shading_vao);
+		glBindVertexArray(meshes_for_instanced_shading_vao);
+		bind_mesh_attributes(instanced_shading.Position_vec4, instanced_shading.Normal_vec3, instanced_shading.Color_vec4, instanced_shading.TexCoord_vec2);
+		glBindBuffer(GL_ARRAY_BUFFER, instances_vbo);
+		point_instance_attribute(instanced_shading.Object_to_world_mat4, 0);
+		for (GLuint column = 0; column < 4; ++column) {
+			glEnableVertexAttribArray(instanced_shading.Object_to_world_mat4 + column);
+			glVertexAttribDivisor(instanced_shading.Object_to_world_mat4 + column, 1);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+	}
 
-		key_counters = {&peanut, &bread, &jelly, &serve};
+	if (assets.atlas) atlas.reset(new TextureAtlas(*assets.atlas));
 
-		level_progression = {&bread, &peanut, &jelly, &bread, &serve};
-		generate_level();
+	//text is baked from the glyph meshes into its own buffer:
+	hud.reset(new HudText(simple_shading.Position_vec4, simple_shading.Normal_vec3, simple_shading.Color_vec4));
+	hud_sandwiches_made = hud->add_glyph(assets.sandwiches_made);
+	size_t longest_digit = 0;
+	for (uint32_t d = 0; d < 10; ++d) {
+		hud_digits[d] = hud->add_glyph(assets.digits[d]);
+		longest_digit = std::max(longest_digit, assets.digits[d].size());
 	}
+	//(plus slack for aligning each allocation)
+	frame_arena.resize(sizeof(HudText::Vertex) * (assets.sandwiches_made.size() + 10 * longest_digit) + 256);
+
+	avatar_mesh = assets.avatar_mesh;
+	counter_mesh = assets.counter_mesh;
+	tile_mesh = assets.tile_mesh;
+	peanut_mesh = assets.peanut_mesh; peanut_gray = assets.peanut_gray;
+	bread_mesh = assets.bread_mesh; bread_gray = assets.bread_gray;
+	jelly_mesh = assets.jelly_mesh; jelly_gray = assets.jelly_gray;
+	serve_mesh = assets.serve_mesh; serve_gray = assets.serve_gray;
+
+	GL_ERRORS();
 }
 
 Game::~Game() {
+	hud.reset();
+	atlas.reset();
+
 	glDeleteVertexArrays(1, &meshes_for_simple_shading_vao);
 	meshes_for_simple_shading_vao = -1U;
 
+	glDeleteVertexArrays(1, &meshes_for_instanced_shading_vao);
+	meshes_for_instanced_shading_vao = -1U;
+
 	glDeleteBuffers(1, &meshes_vbo);
 	meshes_vbo = -1U;
 
-	glDeleteProgram(simple_shading.program);
+	if (meshes_ibo != -1U) {
+		glDeleteBuffers(1, &meshes_ibo);
+		meshes_ibo = -1U;
+	}
+
+	glDeleteBuffers(1, &instances_vbo);
+	instances_vbo = -1U;
+
+	glDeleteBuffers(1, &counter_instances_vbo);
+	counter_instances_vbo = -1U;
+
+	frame_stream.reset();
+
+	//(deletes the programs)
+	shaders.reset();
 	simple_shading.program = -1U;
+	instanced_shading.program = -1U;
 
-	SDL_CloseAudio();
-	SDL_FreeWAV(d0.wav_buffer);
-    SDL_FreeWAV(re.wav_buffer);
-    SDL_FreeWAV(mi.wav_buffer);
-    SDL_FreeWAV(fa.wav_buffer);
-    SDL_FreeWAV(so.wav_buffer);
+	//stop mixing before the note samples are freed along with this object:
+	mixer_shutdown();
 
 	GL_ERRORS();
 }
 
-void Game::generate_level() {
-    auto near_others = [&](uint32_t index, glm::uvec3 location) {
-            for (uint32_t i = 0; i < index; ++i) {
-                if (adjacent(key_counters[i]->location, location, 1.0f)) {
-                    return true;
-                }
-            }
-            return false;
-    };
-
-    // Randomly place key counters on edges
-	std::set< Edge *> remaining_edges = edges;
-	for (uint32_t i = 0; i < 4; ++i) {
-		Edge *edge = *std::next(remaining_edges.begin(), rand()%remaining_edges.size());
-
-		uint32_t max = board_size[edge->is_row];
-		uint32_t increment = edge->is_row ? board_size.x : 1;
-		uint32_t start = edge->is_end * (edge->is_row ? board_size.x-1 : board_size.x*(board_size.y-1));
-
-        uint32_t placement = 1 + rand() % (max-2);
-
-		uint32_t index = start + placement * increment;
-		uint32_t x = index / board_size.x;
-		uint32_t y = index % board_size.x;
-		glm::uvec3 location = glm::uvec3(x, y, 0.0f);
-
-        // Make sure counter doesn't spawn near avatar or each other
-        uint32_t start_placement = placement;
-        while (adjacent(location, avatar_location, 1.0f) || near_others(i, location)) {
-            placement = 1 + (placement + 1) % (max - 2);
-			if (placement == start_placement) {
-				break;
+void Game::setup_programs() {
+	simple_shading.program = shaders->program(simple_shading_index);
+	instanced_shading.program = shaders->program(instanced_shading_index);
+
+	{ //read back uniform and attribute locations from the shader program:
+		simple_shading.object_to_world_mat4 = glGetUniformLocation(simple_shading.program, "object_to_world");
+
+		simple_shading.Position_vec4 = glGetAttribLocation(simple_shading.program, "Position");
+		simple_shading.Normal_vec3 = glGetAttribLocation(simple_shading.program, "Normal");
+		simple_shading.Color_vec4 = glGetAttribLocation(simple_shading.program, "Color");
+
+		instanced_shading.Position_vec4 = glGetAttribLocation(instanced_shading.program, "Position");
+		instanced_shading.Normal_vec3 = glGetAttribLocation(instanced_shading.program, "Normal");
+		instanced_shading.Color_vec4 = glGetAttribLocation(instanced_shading.program, "Color");
+		instanced_shading.Object_to_world_mat4 = glGetAttribLocation(instanced_shading.program, "Object_to_world");
+
+		simple_shading.TexCoord_vec2 = glGetAttribLocation(simple_shading.program, "TexCoord");
+		instanced_shading.TexCoord_vec2 = glGetAttribLocation(instanced_shading.program, "TexCoord");
+	}
+
+	//textured programs sample the atlas from texture unit 0:
+	if (textured) {
+		for (GLuint program : {simple_shading.program, instanced_shading.program}) {
+			glUseProgram(program);
+			glUniform1i(glGetUniformLocation(program, "atlas"), 0);
+		}
+		glUseProgram(0);
+	}
+
+	//connect the programs' Frame blocks to the shared uniform buffer's binding point:
+	for (GLuint program : {simple_shading.program, instanced_shading.program}) {
+		GLuint block = glGetUniformBlockIndex(program, "Frame");
+		if (block == GL_INVALID_INDEX) {
+			throw std::runtime_error("shader program is missing the Frame uniform block.");
+		}
+		glUniformBlockBinding(program, block, FrameBindingPoint);
+	}
+}
+
+void Game::rebuild_board_tiles(glm::uvec2 size) {
+	board_chunk_count = (size + glm::uvec2(BoardChunk - 1)) / uint32_t(BoardChunk);
+	board_chunks.assign(board_chunk_count.x * board_chunk_count.y, BoardChunkInstances());
+
+	//tile transforms, chunk by chunk (first), and one stretched tile per chunk (after):
+	std::vector< glm::mat4 > instances;
+	instances.reserve(size.x * size.y + board_chunks.size());
+	for (uint32_t cy = 0; cy < board_chunk_count.y; ++cy) {
+		for (uint32_t cx = 0; cx < board_chunk_count.x; ++cx) {
+			BoardChunkInstances &chunk = board_chunks[cy * board_chunk_count.x + cx];
+			glm::uvec2 lo = glm::uvec2(cx, cy) * uint32_t(BoardChunk);
+			glm::uvec2 hi = glm::min(lo + glm::uvec2(BoardChunk), size);
+			chunk.first_tile = GLsizei(instances.size());
+			for (uint32_t y = lo.y; y < hi.y; ++y) {
+				for (uint32_t x = lo.x; x < hi.x; ++x) {
+					instances.emplace_back(location_v3m4(glm::vec3(x, y, -0.5f), glm::quat()));
+				}
 			}
-            uint32_t index = start + placement * increment;
-            uint32_t x = index / board_size.x;
-            uint32_t y = index % board_size.x;
-            location = glm::uvec3(x, y, 0.0f);
-        }
-
-		CounterInfo *counter = key_counters[i];
-		counter->location = location;
-
-		// Rotate the serve counter to point outwards
-		if (i == 3) {
-            counter->rotation = glm::quat(glm::vec3(0.0f, 0.0f,
-                    glm::radians((edge->is_row) * 90.0f + (edge->is_end) * 180.0f)));
+			chunk.tiles = GLsizei(instances.size()) - chunk.first_tile;
 		}
+	}
+
+	board_far_first = GLsizei(instances.size());
+	for (uint32_t cy = 0; cy < board_chunk_count.y; ++cy) {
+		for (uint32_t cx = 0; cx < board_chunk_count.x; ++cx) {
+			glm::vec2 lo = glm::vec2(glm::uvec2(cx, cy) * uint32_t(BoardChunk));
+			glm::vec2 hi = glm::vec2(glm::min(glm::uvec2(cx + 1, cy + 1) * uint32_t(BoardChunk), size));
+			glm::mat4 stretched = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f * (lo + hi), -0.5f));
+			instances.emplace_back(glm::scale(stretched, glm::vec3(hi - lo, 1.0f)));
+		}
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, instances_vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * instances.size(), instances.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	board_tiles_size = size;
+
+	//room for every edge cell's counter transform:
+	level_arena.resize(sizeof(glm::mat4) * 2 * (size.x + size.y) + 256);
+}
+
+void Game::rebuild_board_counters(RenderSnapshot const &snapshot) {
+	glm::uvec2 const &size = snapshot.board_size;
+
+	//(the same cells GameState::counter_cells marks, rebuilt here since draw can't read state)
+	board_counter_cells.reset(size);
+	for (uint32_t i = 0; i < KeyCounters; ++i) {
+		board_counter_cells.set(snapshot.counter_locations[i].x, snapshot.counter_locations[i].y);
+	}
+
+	//(the last level's transforms are long since uploaded)
+	level_arena.reset();
+
+	//plain counters fill every edge cell that doesn't hold a key counter:
+	ArenaVector< glm::mat4 > instances{ArenaAllocator< glm::mat4 >(&level_arena)};
+	instances.reserve(2 * (size.x + size.y));
+	auto edge_counter = [&](uint32_t x, uint32_t y) {
+		if (!board_counter_cells.test(x, y)) {
+			instances.emplace_back(location_v3m4(glm::vec3(x, y, 0.0f), glm::quat()));
+		}
+	};
+	for (uint32_t cy = 0; cy < board_chunk_count.y; ++cy) {
+		for (uint32_t cx = 0; cx < board_chunk_count.x; ++cx) {
+			BoardChunkInstances &chunk = board_chunks[cy * board_chunk_count.x + cx];
+			glm::uvec2 lo = glm::uvec2(cx, cy) * uint32_t(BoardChunk);
+			glm::uvec2 hi = glm::min(lo + glm::uvec2(BoardChunk), size);
+			chunk.first_counter = GLsizei(instances.size());
+			//(only the chunk's cells on the board's edges)
+			for (uint32_t x = lo.x; x < hi.x; ++x) {
+				if (lo.y == 0) edge_counter(x, 0);
+				if (hi.y == size.y && size.y > 1) edge_counter(x, size.y-1);
+			}
+			for (uint32_t y = std::max(lo.y, 1u); y < std::min(hi.y, size.y - 1); ++y) {
+				if (lo.x == 0) edge_counter(0, y);
+				if (hi.x == size.x && size.x > 1) edge_counter(size.x-1, y);
+			}
+			chunk.counters = GLsizei(instances.size()) - chunk.first_counter;
+		}
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, counter_instances_vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * instances.size(), instances.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Game::rebuild_hud(uint32_t num_sandwiches) {
+	//hud is drawn with an identity object_to_world, so each glyph's location is added before model_scale is applied:
+	auto glyph_offset = [this](glm::vec3 const &point) {
+		glm::vec3 translation = glm::vec3(location_v3m4(point, glm::quat())[3]);
+		return translation / glm::vec3(model[0][0], model[1][1], model[2][2]);
+	};
 
-		remaining_edges.erase(edge);
+	//digits of the count, least significant first (a uint32_t has at most ten):
+	uint32_t digits[10];
+	uint32_t digit_count = 0;
+	uint32_t num_to_show = num_sandwiches;
+	do {
+		digits[digit_count++] = num_to_show % 10;
+		num_to_show /= 10;
+	} while (num_to_show > 0);
+
+	//the line is laid out in the frame arena, with room reserved for all of it up front:
+	ArenaVector< HudText::Vertex > line{ArenaAllocator< HudText::Vertex >(&frame_arena)};
+	size_t line_vertices = hud->glyphs[hud_sandwiches_made].count;
+	for (uint32_t i = 0; i < digit_count; ++i) {
+		line_vertices += hud->glyphs[hud_digits[digits[i]]].count;
 	}
+	line.reserve(line_vertices);
+
+	glm::vec3 text_point = glm::vec3(1.75f, 1.75f, 0.001f);
+	hud->place(hud_sandwiches_made, glyph_offset(text_point), &line);
+
+	text_point.x += 3.8f;
+	text_point.y -= 0.01f;
+
+	while (digit_count > 0) {
+		hud->place(hud_digits[digits[--digit_count]], glyph_offset(text_point), &line);
+		text_point.x += 0.25f;
+	}
+
+	hud->upload(line);
 }
 
 bool Game::handle_event(SDL_Event const &evt, glm::uvec2 window_size) {
@@ -377,17 +743,24 @@ bool Game::handle_event(SDL_Event const &evt, glm::uvec2 window_size) {
     }
     //handle tracking the state of WASD for avatar movement:
 	if (evt.type == SDL_KEYDOWN || evt.type == SDL_KEYUP) {	// Press/release keys
+		bool pressed = (evt.type == SDL_KEYDOWN);
+		//(events are timestamped in SDL_GetTicks milliseconds when they arrive, which may be well before now)
+		Clock::time_point when = Clock::now() - std::chrono::milliseconds(SDL_GetTicks() - evt.key.timestamp);
 		if (evt.key.keysym.scancode == SDL_SCANCODE_W) {
-			controls.go_up = (evt.type == SDL_KEYDOWN);
+			set_control(&state.controls.go_up, pressed, when);
 			return true;
 		} else if (evt.key.keysym.scancode == SDL_SCANCODE_S) {
-			controls.go_down = (evt.type == SDL_KEYDOWN);
+			set_control(&state.controls.go_down, pressed, when);
 			return true;
 		} else if (evt.key.keysym.scancode == SDL_SCANCODE_A) {
-			controls.go_left = (evt.type == SDL_KEYDOWN);
+			set_control(&state.controls.go_left, pressed, when);
 			return true;
 		} else if (evt.key.keysym.scancode == SDL_SCANCODE_D) {
-			controls.go_right = (evt.type == SDL_KEYDOWN);
+			set_control(&state.controls.go_right, pressed, when);
+			return true;
+		} else if (evt.key.keysym.scancode == SDL_SCANCODE_F5) {
+			//re-read shaders from disk at the next draw (programs are rebuilt only if their source changed):
+			if (evt.type == SDL_KEYDOWN) reload_shaders = true;
 			return true;
 		}
   	}
@@ -395,224 +768,297 @@ bool Game::handle_event(SDL_Event const &evt, glm::uvec2 window_size) {
 	return false;
 }
 
+void Game::sample_controls() {
+	SDL_PumpEvents();
+	Uint8 const *keys = SDL_GetKeyboardState(NULL);
+	Clock::time_point now = Clock::now();
+	set_control(&state.controls.go_up, keys[SDL_SCANCODE_W] != 0, now);
+	set_control(&state.controls.go_down, keys[SDL_SCANCODE_S] != 0, now);
+	set_control(&state.controls.go_left, keys[SDL_SCANCODE_A] != 0, now);
+	set_control(&state.controls.go_right, keys[SDL_SCANCODE_D] != 0, now);
+}
+
+void Game::set_control(float *control, bool pressed, Clock::time_point when) {
+	float value = (pressed ? 1.0f : 0.0f);
+	if (*control == value) return;
+	*control = value;
+	if (!input_pending) {
+		input_pending = true;
+		input_time = when;
+	}
+}
+
 void Game::update(float elapsed) {
+	//play starts once everything is loaded:
+	if (!loaded) return;
 
-    // --------------- Progress -------------------------------
-    {
-    	CounterInfo *next_counter = level_progression[next_pickup];
-    	if (adjacent(next_counter->location, avatar_location, 0.5f)) {
-
-    		// play sound
-    		Sound *next_note = notes[next_pickup];
-    		current_audio_pos = next_note->wav_buffer;
-    		current_audio_len = next_note->wav_length;
-    		if (SDL_OpenAudio(&(next_note->wav_spec), NULL) >= 0) {
-    			SDL_PauseAudio(0);
-    		}
-
-    		++next_pickup;
-    		if (next_pickup == level_progression.size()) {
-	        	++num_sandwiches;
-	        	next_pickup = 0;
-	        	generate_level();
-    		}
-    	}
-    }
+	//(the next frame drawn will show the latest input)
+	if (input_pending) input_simulated = true;
 
-	// --------------- Physics-based movement ---------------
-
-    // NOTE: Movement based on discussion from http://www.cplusplus.com/forum/general/29835/
-    // Default avatar orientation is (1,0);
-    {
-        if (controls.go_left) {
-            x_velocity -= elapsed * acceleration;
-            avatar_rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(180.0f)));
-        }
-        if (controls.go_up) {
-            y_velocity += elapsed * acceleration;
-            avatar_rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(90.0f)));
-        }
-        if (controls.go_right) {
-            x_velocity += elapsed * acceleration;
-            avatar_rotation = glm::quat();
-        }
-        if (controls.go_down) {
-            y_velocity -= elapsed * acceleration;
-            avatar_rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(-90.0f)));
-        }
-
-        // Decelerate to a stop
-        if (!controls.go_left && !controls.go_right && x_velocity != 0.0f) {
-        	int sign = x_velocity < 0 ? -1 : 1;
-            x_velocity -= sign * deceleration * elapsed;
-
-            if (sign > 0) {
-            	x_velocity = glm::clamp(x_velocity, 0.0f, max_velocity);
-            } else {
-            	x_velocity = glm::clamp(x_velocity, -max_velocity, 0.0f);
-            }
-        }
-        if (!controls.go_up && !controls.go_down && y_velocity != 0.0f) {
-			int sign = y_velocity < 0 ? -1 : 1;
-			y_velocity -= sign * deceleration * elapsed;
-
-			if (sign > 0) {
-				y_velocity = glm::clamp(y_velocity, 0.0f, max_velocity);
-			} else {
-				y_velocity = glm::clamp(y_velocity, -max_velocity, 0.0f);
-			}
-        }
-
-        x_velocity = glm::clamp(x_velocity, -max_velocity, max_velocity);
-        y_velocity = glm::clamp(y_velocity, -max_velocity, max_velocity);
-        assert(-max_velocity <= x_velocity && x_velocity <= max_velocity);
-        assert(-max_velocity <= y_velocity && y_velocity <= max_velocity);
-        glm::vec3 mv = x_velocity * glm::vec3(1.0f, 0.0f, 0.0f) + y_velocity * glm::vec3(0.0f, 1.0f, 0.0f);
-
-        if (mv != glm::vec3(0.0f, 0.0f, 0.0f)) {
-            avatar_location += mv;
-            avatar_location.x = glm::clamp(avatar_location.x, 1.0f, (float) board_size.x - 2);
-            avatar_location.y = glm::clamp(avatar_location.y, 1.0f, (float) board_size.y - 2);
-
-            // Prevent avatar from "sticking" to counters
-            if (avatar_location.x == 1.0f || avatar_location.x == board_size.x - 2) {
-                x_velocity = 0.0f;
-            }
-            if (avatar_location.y == 1.0f || avatar_location.y == board_size.y - 2) {
-                y_velocity = 0.0f;
-            }
-        }
-    }
+	uint32_t sandwiches_before = state.num_sandwiches;
+	state.update(elapsed);
+
+	//each sandwich made starts a new level:
+	if (metrics && state.num_sandwiches != sandwiches_before) {
+		metrics->sandwiches.fetch_add(state.num_sandwiches - sandwiches_before, std::memory_order_relaxed);
+		metrics->level_generation_ms.add(state.level_generation_ms);
+	}
+
+	//play the note for whatever was just picked up:
+	if (state.picked_up >= 0) {
+		Sound *note = notes[state.picked_up];
+		mixer_play(note->samples, note->frames, AUDIO_VOLUME);
+	}
+}
+
+void Game::snapshot(RenderSnapshot *snapshot) const {
+	snapshot->previous_avatar_location = state.previous_avatar_location;
+	snapshot->avatar_location = state.avatar_location;
+	snapshot->previous_avatar_rotation = state.previous_avatar_rotation;
+	snapshot->avatar_rotation = state.avatar_rotation;
+	GameState::CounterInfo const *current_counter = state.level_progression[state.next_pickup];
+	for (uint32_t i = 0; i < KeyCounters; ++i) {
+		snapshot->counter_locations[i] = state.key_counters[i]->location;
+		snapshot->counter_rotations[i] = state.key_counters[i]->rotation;
+		if (state.key_counters[i] == current_counter) snapshot->active_counter = i;
+	}
+	snapshot->num_sandwiches = state.num_sandwiches;
+	snapshot->board_size = state.board_size;
+	snapshot->level_serial = state.level_serial;
 }
 
-void Game::draw(glm::uvec2 drawable_size) {
-	//Set up a transformation matrix to fit the board in the window:
-	glm::mat4 world_to_clip;
-	{
-		float aspect = float(drawable_size.x) / float(drawable_size.y);
+void Game::draw(glm::uvec2 drawable_size, RenderSnapshot const &snapshot, float alpha) {
+	if (!loaded) {
+		finish_loading();
+		if (!loaded) {
+			draw_loading(drawable_size);
+			return;
+		}
+	}
 
-		//want scale such that board * scale fits in [-aspect,aspect]x[-1.0,1.0] screen box with some leeway for shear:
-		float scale = glm::min(
-			1.75f * aspect / float(board_size.x),
-			1.75f / float(board_size.y)
-		);
+	if (reload_shaders.exchange(false) && shaders->reload()) {
+		setup_programs();
+	}
+
+	draw_calls = 0;
 
-		//center of board will be placed at center of screen:
-		glm::vec2 center = 0.5f * glm::vec2(board_size);
+	float aspect = float(drawable_size.x) / float(drawable_size.y);
 
-		//NOTE: glm matrices are specified in column-major order
-		world_to_clip = glm::mat4(
-			scale / aspect, 0.0f, 0.0f, 0.0f,
-			0.0f, scale, 0.0f, 0.0f,
-			0.0f, 0.0f, -1.0f, 0.0f,
-			-(scale / aspect) * center.x, -scale * center.y, 0.0f, 1.0f
-		);
+	//the camera looks at 'center', fitting 'extent' cells in the window:
+	glm::vec2 center, extent;
+	if (follow_camera) {
+		glm::vec3 avatar = glm::mix(snapshot.previous_avatar_location, snapshot.avatar_location, alpha);
+		center = glm::vec2(avatar.x, avatar.y) + glm::vec2(0.5f);
+		extent = glm::vec2(view_cells);
+	} else {
+		center = 0.5f * glm::vec2(snapshot.board_size);
+		extent = glm::vec2(snapshot.board_size);
 	}
+	float scale = fit_scale(extent, aspect);
+	glm::mat4 world_to_clip = view_to_clip(center, scale, aspect);
 
-	//set up graphics pipeline to use data from the meshes and the simple shading program:
-	glBindVertexArray(meshes_for_simple_shading_vao);
-	glUseProgram(simple_shading.program);
+	//HUD text is laid out for the view of the original 9x9 board, wherever the camera is:
+	glm::mat4 hud_to_clip = view_to_clip(glm::vec2(4.5f), fit_scale(glm::vec2(9.0f), aspect), aspect);
+
+	{ //upload camera and lighting state for every pass of this frame:
+		FrameUniforms frame;
+		frame.model_scale = model;
+		frame.sun_color = glm::vec4(0.81f, 0.81f, 0.76f, 0.0f);
+		frame.sun_direction = glm::vec4(glm::normalize(glm::vec3(0.4f, -0.4f, 1.0f)), 0.0f);
+		frame.sky_color = glm::vec4(0.2f, 0.2f, 0.3f, 0.0f);
+		frame.sky_direction = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
 
-	glUniform3fv(simple_shading.sun_color_vec3, 1, glm::value_ptr(glm::vec3(0.81f, 0.81f, 0.76f)));
-	glUniform3fv(simple_shading.sun_direction_vec3, 1, glm::value_ptr(glm::normalize(glm::vec3(0.4f, -0.4f, 1.0f))));
-	glUniform3fv(simple_shading.sky_color_vec3, 1, glm::value_ptr(glm::vec3(0.2f, 0.2f, 0.3f)));
-	glUniform3fv(simple_shading.sky_direction_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 1.0f, 0.0f)));
+		frame_stream->begin_frame();
+
+		//board and avatar are seen through the sheared view:
+		frame.world_to_clip = world_to_clip * shear_z * scale_z;
+		frame_offsets[WorldPass] = frame_stream->write(&frame, sizeof(FrameUniforms));
+
+		//HUD text is drawn flat:
+		frame.world_to_clip = hud_to_clip;
+		frame_offsets[HudPass] = frame_stream->write(&frame, sizeof(FrameUniforms));
+	}
+
+	//select which pass's copy of the Frame block the programs read:
+	auto bind_pass = [&](GLsizei pass) {
+		glBindBufferRange(GL_UNIFORM_BUFFER, FrameBindingPoint, frame_stream->buffer, frame_offsets[pass], sizeof(FrameUniforms));
+	};
 
 	//helper function to draw a given mesh with a given transformation:
 	auto draw_mesh = [&](Mesh const &mesh, glm::mat4 const &object_to_world) {
-		//set up the matrix uniforms:
-		if (simple_shading.object_to_clip_mat4 != -1U) {
-			glm::mat4 object_to_clip = world_to_clip * shear_z * scale_z * object_to_world;
-			glUniformMatrix4fv(simple_shading.object_to_clip_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
-		}
-		if (simple_shading.object_to_light_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(simple_shading.object_to_light_mat4x3, 1, GL_FALSE, glm::value_ptr(object_to_world));
-		}
-		if (simple_shading.normal_to_light_mat3 != -1U) {
-			//NOTE: if there isn't any non-uniform scaling in the object_to_world matrix, then the inverse transpose is the matrix itself, and computing it wastes some CPU time:
-			glm::mat3 normal_to_world = glm::inverse(glm::transpose(glm::mat3(object_to_world)));
-			glUniformMatrix3fv(simple_shading.normal_to_light_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_world));
-		}
-        if (simple_shading.model_scale_mat4 != -1U) {
-            glUniformMatrix4fv(simple_shading.model_scale_mat4, 1, GL_FALSE, glm::value_ptr(model));
-        }
+		//the object transform is the only per-draw uniform:
+		glUniformMatrix4fv(simple_shading.object_to_world_mat4, 1, GL_FALSE, glm::value_ptr(object_to_world));
 
 		//draw the mesh:
-		glDrawArrays(GL_TRIANGLES, mesh.first, mesh.count);
+		draw_mesh_instances(mesh, 1);
+		++draw_calls;
 	};
 
-	auto on_edge = [&](const uint32_t x, const uint32_t y) -> bool {
-        return x == 0 || x == board_size.x-1 || y == 0 || y == board_size.y-1;
-	};
+	//every textured mesh shares the one atlas texture (the HUD text, which has no texture coordinates, samples its white cell):
+	if (atlas) atlas->bind(0);
 
-	auto not_occupied = [&](const uint32_t x, const uint32_t y) -> bool {
-        glm::uvec3 compare = glm::uvec3(x,y,0);
-        for (CounterInfo *c : key_counters) {
-			if (c->location == compare) {
-				return false;
-			}
-        }
-        return true;
-	};
+	bind_pass(WorldPass);
+	if (profiler) profiler->gpu_begin(Profiler::WorldPass);
 
-	for (uint32_t i = 0; i < board_size.x * board_size.y; ++i) {
-		uint32_t x = i / board_size.x;
-		uint32_t y = i % board_size.y;
-		draw_mesh(tile_mesh, location_v3m4(glm::vec3(x, y, -0.5f), glm::quat()));
+	//the tile grid only changes with the board size, and the free edge counters when the level does:
+	if (board_tiles_size != snapshot.board_size) {
+		rebuild_board_tiles(snapshot.board_size);
+		board_level_serial = -1U;
+	}
+	if (board_level_serial != snapshot.level_serial) {
+		rebuild_board_counters(snapshot);
+		board_level_serial = snapshot.level_serial;
+	}
 
-		if (on_edge(x,y) && not_occupied(x,y)) {
-			draw_mesh(counter_mesh, location_v3m4(glm::vec3(x,y,0.0f), glm::quat()));
+	{ //draw the board's chunks that are in view, with one instanced draw per run of neighboring chunks at the same detail:
+		glBindVertexArray(meshes_for_instanced_shading_vao);
+		glUseProgram(instanced_shading.program);
+
+		auto draw_instances = [&](GLuint vbo, Mesh const &mesh, GLsizei first, GLsizei count) {
+			if (count == 0) return;
+			glBindBuffer(GL_ARRAY_BUFFER, vbo);
+			point_instance_attribute(instanced_shading.Object_to_world_mat4, first);
+			draw_mesh_instances(mesh, count);
+			++draw_calls;
+		};
+
+		//cells in view (the sheared view draws things up to a cell or so from their own cell, hence the margin):
+		glm::vec2 half_view = glm::vec2(aspect, 1.0f) / scale + glm::vec2(2.0f);
+		glm::vec2 view_min = center - half_view;
+		glm::vec2 view_max = center + half_view;
+		glm::vec2 board_max = glm::vec2(snapshot.board_size);
+
+		if (view_max.x > 0.0f && view_max.y > 0.0f && view_min.x < board_max.x && view_min.y < board_max.y) {
+			glm::uvec2 chunk_min = glm::uvec2(glm::max(view_min, glm::vec2(0.0f))) / uint32_t(BoardChunk);
+			glm::uvec2 chunk_max = glm::min(glm::uvec2(view_max) / uint32_t(BoardChunk), board_chunk_count - glm::uvec2(1));
+
+			//far chunks are those with no cell within far_fraction of the way from the center of the view to its corner:
+			float far_distance = far_fraction * glm::length(half_view);
+			auto is_far = [&](uint32_t cx, uint32_t cy) {
+				glm::vec2 lo = glm::vec2(glm::uvec2(cx, cy) * uint32_t(BoardChunk));
+				glm::vec2 hi = glm::min(lo + glm::vec2(float(BoardChunk)), board_max);
+				return glm::length(center - glm::clamp(center, lo, hi)) > far_distance;
+			};
+
+			for (uint32_t cy = chunk_min.y; cy <= chunk_max.y; ++cy) {
+				BoardChunkInstances const *row = &board_chunks[cy * board_chunk_count.x];
+
+				//a row's chunks are consecutive in the instance buffers, so each run of near (or far) chunks is one draw:
+				auto draw_run = [&](uint32_t begin, uint32_t end, bool far) {
+					if (far) {
+						draw_instances(instances_vbo, tile_mesh, board_far_first + GLsizei(cy * board_chunk_count.x + begin), GLsizei(end - begin));
+					} else {
+						draw_instances(instances_vbo, tile_mesh, row[begin].first_tile, row[end-1].first_tile + row[end-1].tiles - row[begin].first_tile);
+					}
+				};
+				uint32_t run_begin = chunk_min.x;
+				bool run_far = is_far(run_begin, cy);
+				for (uint32_t cx = chunk_min.x + 1; cx <= chunk_max.x; ++cx) {
+					bool far = is_far(cx, cy);
+					if (far != run_far) {
+						draw_run(run_begin, cx, run_far);
+						run_begin = cx;
+						run_far = far;
+					}
+				}
+				draw_run(run_begin, chunk_max.x + 1, run_far);
+
+				//(counters are drawn at full detail everywhere)
+				draw_instances(counter_instances_vbo, counter_mesh, row[chunk_min.x].first_counter,
+					row[chunk_max.x].first_counter + row[chunk_max.x].counters - row[chunk_min.x].first_counter);
+			}
 		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
-	draw_mesh(avatar_mesh, location_v3m4(avatar_location, avatar_rotation));
+	//set up graphics pipeline to use data from the meshes and the simple shading program:
+	glBindVertexArray(meshes_for_simple_shading_vao);
+	glUseProgram(simple_shading.program);
 
-	CounterInfo *current_counter = level_progression[next_pickup];
-	for (CounterInfo *c : key_counters) {
-		if (c == current_counter) {
-			draw_mesh(*(c->active), location_v3m4(c->location, c->rotation));
+	//avatar is drawn between its last two simulated states so motion stays smooth whatever the tick rate:
+	draw_mesh(avatar_mesh, location_v3m4(
+		glm::mix(snapshot.previous_avatar_location, snapshot.avatar_location, alpha),
+		glm::slerp(snapshot.previous_avatar_rotation, snapshot.avatar_rotation, alpha)
+	));
+
+	for (uint32_t i = 0; i < KeyCounters; ++i) {
+		glm::mat4 object_to_world = location_v3m4(snapshot.counter_locations[i], snapshot.counter_rotations[i]);
+		if (i == snapshot.active_counter) {
+			draw_mesh(*key_counter_meshes[i].active, object_to_world);
 		} else {
-			draw_mesh(*(c->inactive), location_v3m4(c->location, c->rotation));
+			draw_mesh(*key_counter_meshes[i].inactive, object_to_world);
 		}
 	}
 
-	auto draw_text = [&](Mesh const &mesh, glm::mat4 const &object_to_world) {
-		glm::mat4 object_to_clip = world_to_clip * object_to_world;
-		glUniformMatrix4fv(simple_shading.object_to_clip_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
+	if (profiler) profiler->gpu_end();
 
-		glDrawArrays(GL_TRIANGLES, mesh.first, mesh.count);
-	};
+	//text uses the same program with the unsheared HUD camera:
+	bind_pass(HudPass);
+	if (profiler) profiler->gpu_begin(Profiler::HudPass);
 
-	glm::vec3 text_point = glm::vec3(1.75f, 1.75f, 0.001f);
-	draw_text(sandwiches_made, location_v3m4(text_point, glm::quat()));
+	//the text only changes when a sandwich is made:
+	if (hud_shown_sandwiches != snapshot.num_sandwiches) {
+		rebuild_hud(snapshot.num_sandwiches);
+		hud_shown_sandwiches = snapshot.num_sandwiches;
+	}
 
-	text_point.x += 3.8f;
-	text_point.y -= 0.01f;
+	//glyph locations are baked into hud's vertices:
+	glUniformMatrix4fv(simple_shading.object_to_world_mat4, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+	hud->draw();
+	if (hud->uploaded_count) ++draw_calls;
 
-	if (num_sandwiches == 0) {
-		draw_text(num0, location_v3m4(text_point, glm::quat()));
-	} else {
-		uint32_t num_to_show = num_sandwiches;
-		std::vector< uint32_t > order;
+	if (profiler) profiler->gpu_end();
 
-		while (num_to_show > 0) {
-			uint32_t last_digit = num_to_show % 10;
-			order.insert(order.begin(), last_digit);
-			num_to_show /= 10;
-		}
+	glUseProgram(0);
 
-		for (uint32_t i = 0; i < order.size(); ++i) {
-			uint32_t d = order[i];
-			draw_text(*digits[d], location_v3m4(text_point, glm::quat()));
-			text_point.x += 0.25f;
-		}
-	}
+	//this frame's uniforms can be reused once the GPU has passed this point:
+	frame_stream->end_frame();
 
-	glUseProgram(0);
+	//(nothing allocated from the frame arena outlives draw)
+	frame_arena.reset();
 
 	GL_ERRORS();
 }
 
+void Game::draw_loading(glm::uvec2 drawable_size) {
+	//shaders are compiled first (in the constructor), then meshes and sounds arrive in either order:
+	float progress = (1.0f + (meshes_loaded ? 1.0f : 0.0f) + (sounds_loaded ? 1.0f : 0.0f)) / 3.0f;
+
+	//there may be no meshes yet, so the bar is drawn by clearing rectangles:
+	GLint width = GLint(drawable_size.x / 2);
+	GLint height = std::max(GLint(drawable_size.y / 40), GLint(4));
+	GLint x = (GLint(drawable_size.x) - width) / 2;
+	GLint y = (GLint(drawable_size.y) - height) / 2;
+
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(x, y, width, height);
+	glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glScissor(x, y, GLint(width * progress), height);
+	glClearColor(0.9f, 0.9f, 0.8f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glDisable(GL_SCISSOR_TEST);
+
+	GL_ERRORS();
+}
+
+//scale (clip units per cell) at which 'extent' cells fit in the window's [-aspect,aspect]x[-1,1] box with some leeway for shear:
+static float fit_scale(glm::vec2 extent, float aspect) {
+	return glm::min(1.75f * aspect / extent.x, 1.75f / extent.y);
+}
+
+//a view that puts 'center' at the center of the window, at 'scale' clip units per cell:
+static glm::mat4 view_to_clip(glm::vec2 center, float scale, float aspect) {
+	//NOTE: glm matrices are specified in column-major order
+	return glm::mat4(
+		scale / aspect, 0.0f, 0.0f, 0.0f,
+		0.0f, scale, 0.0f, 0.0f,
+		0.0f, 0.0f, -1.0f, 0.0f,
+		-(scale / aspect) * center.x, -scale * center.y, 0.0f, 1.0f
+	);
+}
+
 static glm::mat4 location_v3m4(glm::vec3 v, glm::quat r) {
 	return 	glm::mat4(
 			1.0f, 0.0f, 0.0f, 0.0f,
@@ -622,56 +1068,53 @@ static glm::mat4 location_v3m4(glm::vec3 v, glm::quat r) {
 	) * glm::mat4_cast(r);
 }
 
-// Positions on grid where locationB is adjacent to locationA with leeway of 0.0f:
-//          B B B
-//          B A B
-//          B B B
-static bool adjacent(glm::vec3 locationA, glm::vec3 locationB, float leeway) {
-    float x_lo = locationA.x - 1.0f - leeway;
-    float x_hi = locationA.x + 2.0f + leeway;
-    float y_lo = locationA.y - 1.0f - leeway;
-    float y_hi = locationA.y + 2.0f + leeway;
-
-    if ((locationB.x >= x_lo && locationB.x + 1.0f <= x_hi) &&
-        (locationB.y >= y_lo && locationB.y + 1.0f <= y_hi)) {
-        return true;
-    }
-    return false;
+//point the four columns of a per-instance mat4 attribute at the transform of first_instance in the currently bound GL_ARRAY_BUFFER:
+// (GL 3.3 has no base-instance draws, so instanced draws of different meshes re-point this between calls)
+static void point_instance_attribute(GLuint location, GLsizei first_instance) {
+	for (GLuint column = 0; column < 4; ++column) {
+		glVertexAttribPointer(location + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+			(GLbyte *)0 + first_instance * sizeof(glm::mat4) + column * sizeof(glm::vec4));
+	}
 }
 
-// NOTE: based on code from https://gist.github.com/armornick/3447121
-static void audio_callback(void *userdata, Uint8 *stream, int len) {
-	if (current_audio_len == 0) {
-		return;
+//draw instance_count copies of a mesh with the currently bound program and vertex array object:
+static void draw_mesh_instances(Game::Mesh const &mesh, GLsizei instance_count) {
+	if (mesh.index_count != 0) {
+		GLbyte const *indices = (GLbyte *)0 + mesh.index_first * sizeof(uint16_t);
+		if (instance_count == 1) {
+			glDrawElementsBaseVertex(GL_TRIANGLES, mesh.index_count, GL_UNSIGNED_SHORT, indices, mesh.first);
+		} else {
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.index_count, GL_UNSIGNED_SHORT, indices, instance_count, mesh.first);
+		}
+	} else {
+		if (instance_count == 1) {
+			glDrawArrays(GL_TRIANGLES, mesh.first, mesh.count);
+		} else {
+			glDrawArraysInstanced(GL_TRIANGLES, mesh.first, mesh.count, instance_count);
+		}
 	}
+}
 
-	len = ( len > (int)current_audio_len ? current_audio_len : len );
-    SDL_memset(stream, 0, len);
-    SDL_MixAudio(stream, current_audio_pos, len, AUDIO_VOLUME);
-
-	current_audio_pos += len;
-	current_audio_len -= len;
+//decode an IEEE 754 half-precision float (as stored in 'dat1' vertex positions):
+static float half_to_float(uint16_t h) {
+	uint32_t exponent = (h >> 10) & 0x1f;
+	uint32_t mantissa = h & 0x3ff;
+	float magnitude;
+	if (exponent == 0) {
+		magnitude = std::ldexp(float(mantissa), -24); //zero or subnormal
+	} else if (exponent == 0x1f) {
+		magnitude = (mantissa ? std::numeric_limits< float >::quiet_NaN() : std::numeric_limits< float >::infinity());
+	} else {
+		magnitude = std::ldexp(float(mantissa | 0x400), int32_t(exponent) - 25);
+	}
+	return (h & 0x8000) ? -magnitude : magnitude;
 }
 
-//create and return an OpenGL vertex shader from source:
-static GLuint compile_shader(GLenum type, std::string const &source) {
-	GLuint shader = glCreateShader(type);
-	GLchar const *str = source.c_str();
-	GLint length = GLint(source.size());
-	glShaderSource(shader, 1, &str, &length);
-	glCompileShader(shader);
-	GLint compile_status = GL_FALSE;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
-	if (compile_status != GL_TRUE) {
-		std::cerr << "Failed to compile shader." << std::endl;
-		GLint info_log_length = 0;
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_length);
-		std::vector< GLchar > info_log(info_log_length, 0);
-		GLsizei length = 0;
-		glGetShaderInfoLog(shader, GLsizei(info_log.size()), &length, &info_log[0]);
-		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
-		glDeleteShader(shader);
-		throw std::runtime_error("Failed to compile shader.");
-	}
-	return shader;
+//decode a signed normalized 2_10_10_10 normal (x in the low bits) the way the exporter encoded it (c/511):
+static glm::vec3 unpack_normal(uint32_t n) {
+	auto component = [n](uint32_t shift) {
+		int32_t c = int32_t(n << (22 - shift)) >> 22; //sign-extend the ten bits starting at 'shift'
+		return std::max(float(c) / 511.0f, -1.0f);
+	};
+	return glm::vec3(component(0), component(10), component(20));
 }
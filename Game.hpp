@@ -1,6 +1,8 @@
 #pragma once
 
 #include "GL.hpp"
+#include "GameState.hpp"
+#include "Arena.hpp"
 
 #include <SDL.h>
 #include <glm/glm.hpp>
@@ -8,7 +10,18 @@
 #include <glm/gtc/quaternion.hpp>
 
 #include <vector>
-#include <set>
+#include <memory>
+#include <atomic>
+#include <future>
+#include <chrono>
+
+struct MappedFile; //mapped_file.hpp
+struct HudText; //HudText.hpp
+struct Profiler; //Profiler.hpp
+struct Metrics; //Metrics.hpp
+struct StreamBuffer; //StreamBuffer.hpp
+struct ShaderCache; //ShaderCache.hpp
+struct TextureAtlas; //TextureAtlas.hpp
 
 // The 'Game' struct holds all of the game-relevant state,
 // and is called by the main loop.
@@ -16,7 +29,9 @@
 struct Game {
 	//Game creates OpenGL resources (i.e. vertex buffer objects) in its
 	//constructor and frees them in its destructor.
-	Game();
+	//Meshes and sounds are loaded in the background; until they arrive, draw shows a progress bar and update does nothing.
+	//'seed' determines the sequence of levels (see GameState::set_seed):
+	explicit Game(uint64_t seed);
 	~Game();
 
 	//handle_event is called when new mouse or keyboard events are received:
@@ -24,42 +39,146 @@ struct Game {
 	//The function should return 'true' if it handled the event.
 	bool handle_event(SDL_Event const &evt, glm::uvec2 window_size);
 
-	//update is called at the start of a new frame, after events are handled:
+	//sample_controls sets the controls from the keyboard's current state, pumping SDL's event queue first
+	// (main calls this just before each tick with --late-input, so ticks see keys pressed since events were polled):
+	void sample_controls();
+
+	//update advances the simulation by one step of 'elapsed' seconds:
+	// (main calls this zero or more times per frame with a fixed tick length, or once per frame with variable timestep)
 	void update(float elapsed);
 
-	//draw is called after update:
-	void draw(glm::uvec2 drawable_size);
+	//everything draw needs from the simulation, copied out of 'state' by snapshot(), so that draw never reads 'state' itself
+	// and can run on a render thread while the next ticks are simulated (see RenderThread.hpp):
+	struct RenderSnapshot {
+		//avatar as of the previous tick and the latest one:
+		glm::vec3 previous_avatar_location;
+		glm::vec3 avatar_location;
+		glm::quat previous_avatar_rotation;
+		glm::quat avatar_rotation;
+		//key counters, in state.key_counters order:
+		glm::uvec3 counter_locations[KeyCounters];
+		glm::quat counter_rotations[KeyCounters];
+		uint32_t active_counter = 0; //the next pickup
+		uint32_t num_sandwiches = 0;
+		glm::uvec2 board_size = glm::uvec2(0);
+		uint32_t level_serial = 0;
+	};
+	void snapshot(RenderSnapshot *snapshot) const;
+
+	//draw is called with a snapshot taken after update:
+	// 'alpha' is how far (in [0,1]) the frame falls between the previous tick and the latest one
+	void draw(glm::uvec2 drawable_size, RenderSnapshot const &snapshot, float alpha = 1.0f);
+
+	//------- loading -------
+
+	//asset files are mapped and checked on worker threads (see Game.cpp),
+	// then finish_loading (called by draw) uploads each to the GPU once it is ready:
+	struct MeshAssets;
+	struct SoundAssets;
+	std::future< std::unique_ptr< MeshAssets > > mesh_assets;
+	std::future< std::unique_ptr< SoundAssets > > sound_assets;
+	bool meshes_loaded = false;
+	bool sounds_loaded = false;
+	//everything is in place, so play can start:
+	// (set by draw and read by update, which may be on different threads; assets are in place before it is set)
+	std::atomic< bool > loaded{false};
+
+	void finish_loading();
+	void upload_meshes(MeshAssets const &assets);
+	void draw_loading(glm::uvec2 drawable_size); //progress bar
+
+	//if set (by main), draw times its passes on the GPU:
+	Profiler *profiler = nullptr;
+
+	//if set (by main), update counts sandwiches and level generation times in it:
+	Metrics *metrics = nullptr;
+
+	//draw calls issued by the latest draw (main reports these to metrics):
+	uint32_t draw_calls = 0;
+
+	//------- input latency -------
+
+	//when the controls first changed since a frame last showed them (from the key event's timestamp, or when sample_controls saw it);
+	// update marks the change as simulated, and main measures input-to-photon time once the frame drawing it is swapped:
+	typedef std::chrono::high_resolution_clock Clock;
+	bool input_pending = false;
+	bool input_simulated = false;
+	Clock::time_point input_time;
+	void set_control(float *control, bool pressed, Clock::time_point when);
 
 	//------- opengl resources -------
 
+	//simple_shading and instanced_shading are built from dist/shaders/ (F5 reloads them):
+	std::unique_ptr< ShaderCache > shaders;
+	uint32_t simple_shading_index = -1U; //programs in shaders
+	uint32_t instanced_shading_index = -1U;
+	void setup_programs(); //(re)read program objects and locations from shaders; binds Frame blocks
+	std::atomic< bool > reload_shaders{false}; //set by handle_event (F5); draw does the reload, since it owns GL
+	bool textured = false; //the mesh blob has atlas texture coordinates ('dat2'), so the programs are built to sample the atlas
+
 	//shader program that draws lit objects with vertex colors:
 	struct {
 		GLuint program = -1U; //program object
 
 		//uniform locations:
-		GLuint object_to_clip_mat4 = -1U;
-        GLuint model_scale_mat4 = -1U;
-		GLuint object_to_light_mat4x3 = -1U;
-		GLuint normal_to_light_mat3 = -1U;
-		GLuint sun_direction_vec3 = -1U;
-		GLuint sun_color_vec3 = -1U;
-		GLuint sky_direction_vec3 = -1U;
-		GLuint sky_color_vec3 = -1U;
+		GLuint object_to_world_mat4 = -1U;
 
 		//attribute locations:
 		GLuint Position_vec4 = -1U;
 		GLuint Normal_vec3 = -1U;
 		GLuint Color_vec4 = -1U;
+		GLuint TexCoord_vec2 = -1U;
 
 	} simple_shading;
 
+	//shader program that draws many copies of a mesh, one object_to_world transform per instance:
+	struct {
+		GLuint program = -1U; //program object
+
+		//attribute locations:
+		GLuint Position_vec4 = -1U;
+		GLuint Normal_vec3 = -1U;
+		GLuint Color_vec4 = -1U;
+		GLuint TexCoord_vec2 = -1U;
+		GLuint Object_to_world_mat4 = -1U; //per-instance; occupies four consecutive locations
+
+	} instanced_shading;
+
+	//camera and lighting state shared by both programs through the std140 'Frame' uniform block:
+	struct FrameUniforms {
+		glm::mat4 world_to_clip;
+		glm::mat4 model_scale;
+		glm::vec4 sun_direction;
+		glm::vec4 sun_color;
+		glm::vec4 sky_direction;
+		glm::vec4 sky_color;
+	};
+	static_assert(sizeof(FrameUniforms) == 2 * 64 + 4 * 16, "FrameUniforms should match std140 layout.");
+
+	//each frame, draw writes one FrameUniforms per pass (board + avatar, then HUD text) to frame_stream:
+	// (per-frame data goes through a fenced StreamBuffer, so writing it never waits on draws still reading the last frames')
+	enum : GLuint { FrameBindingPoint = 0 };
+	enum : GLsizei { WorldPass = 0, HudPass = 1, FramePasses = 2 };
+	std::unique_ptr< StreamBuffer > frame_stream;
+	GLintptr frame_offsets[FramePasses] = {}; //this frame's pass uniforms, in frame_stream->buffer
+
 	//mesh data, stored in a vertex buffer:
 	GLuint meshes_vbo = -1U; //vertex buffer holding mesh data
+	GLuint meshes_ibo = -1U; //16-bit triangle indices (only for blobs in the indexed 'dat1' and 'dat2' formats)
+
+	//mesh textures, bound once per frame (only made for textured meshes):
+	std::unique_ptr< TextureAtlas > atlas;
+
+	//per-instance transforms (glm::mat4 object_to_world) for instanced draws:
+	GLuint instances_vbo = -1U;
 
 	//The location of each mesh in the meshes vertex buffer:
+	// (indexed meshes are drawn from their range of meshes_ibo, with 'first' as the base vertex)
 	struct Mesh {
 		GLint first = 0;
 		GLsizei count = 0;
+		GLuint index_first = 0;
+		GLsizei index_count = 0; //0 for unindexed meshes
 	};
 
     Mesh avatar_mesh;
@@ -71,6 +190,37 @@ struct Game {
     Mesh serve_mesh; Mesh serve_gray;
 
 	GLuint meshes_for_simple_shading_vao = -1U; //vertex array object that describes how to connect the meshes_vbo to the simple_shading_program
+	GLuint meshes_for_instanced_shading_vao = -1U; //connects meshes_vbo (per-vertex) and instances_vbo (per-instance) to the instanced_shading program
+
+	//static board geometry, kept in chunks of BoardChunk x BoardChunk cells so draw can skip chunks out of view:
+	// instances_vbo holds tile transforms, chunk by chunk, then one tile stretched over each chunk (drawn in place of far chunks' tiles);
+	// it is rebuilt only when the board size changes.
+	// counter_instances_vbo holds the free edge counters' transforms, chunk by chunk; it is rebuilt when the drawn level_serial changes.
+	enum : uint32_t { BoardChunk = 16 };
+	struct BoardChunkInstances {
+		GLsizei first_tile = 0;
+		GLsizei tiles = 0;
+		GLsizei first_counter = 0;
+		GLsizei counters = 0;
+	};
+	std::vector< BoardChunkInstances > board_chunks; //row-major
+	glm::uvec2 board_chunk_count = glm::uvec2(0);
+	glm::uvec2 board_tiles_size = glm::uvec2(0); //the board size instances_vbo was built for
+	GLsizei board_far_first = 0; //instance of the first chunk's stretched tile
+	uint32_t board_level_serial = -1U;
+	OccupancyGrid board_counter_cells; //the key counters' cells, as of board_level_serial
+	GLuint counter_instances_vbo = -1U;
+
+	//------- camera -------
+
+	//the camera fits the whole board in the window unless follow_camera is set (by main),
+	// in which case it tracks the avatar, fitting view_cells cells across:
+	bool follow_camera = false;
+	float view_cells = 16.0f;
+
+	//chunks with no cell within this fraction of the distance from the view's center to its corner are drawn as one stretched tile:
+	// (relative to the view, so the outer part of it is drawn at low detail however far the camera is zoomed out)
+	float far_fraction = 0.5f;
 
 	//---- transformations -----
 	// NOTE: Based on discussion from https://solarianprogrammer.com/2013/05/22/opengl-101-matrices-projection-view-model/
@@ -87,12 +237,14 @@ struct Game {
     glm::mat4 scale_z = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, 1.0f, 0.25f));
 
     //------- sound ------------
-    // NOTE: Based on code from https://gist.github.com/armornick/3447121
 
+    //notes.blob, mapped for as long as the notes can be playing (from SoundAssets, once loaded):
+    std::unique_ptr< MappedFile > sound_bank;
+
+    //a range of sound_bank's samples:
     struct Sound {
-        uint32_t wav_length;
-        uint8_t *wav_buffer;
-        SDL_AudioSpec wav_spec;
+        int16_t const *samples = nullptr; //interleaved stereo, in the mixer's format (see mixer.hpp)
+        uint32_t frames = 0;
     };
 
     Sound d0;
@@ -103,72 +255,40 @@ struct Game {
 
     //------- text ------------
 
-    Mesh sandwiches_made;
-    Mesh num0;
-    Mesh num1;
-    Mesh num2;
-    Mesh num3;
-    Mesh num4;
-    Mesh num5;
-    Mesh num6;
-    Mesh num7;
-    Mesh num8;
-    Mesh num9;
-    std::vector< Mesh * > digits;
+    //"sandwiches made" and the state.num_sandwiches count, baked into one vertex buffer:
+    std::unique_ptr< HudText > hud;
+    uint32_t hud_sandwiches_made = 0; //glyph indices in hud
+    uint32_t hud_digits[10] = {};
+    uint32_t hud_shown_sandwiches = -1U; //the count hud was last laid out for
+
+	//------- transient memory -------
+
+	//so that steady-state frames never touch the heap, data that only lives for a while is allocated from arenas:
+	// frame_arena holds what draw uses until it returns (e.g. hud's line layout); draw resets it as it finishes.
+	// It is sized (when the glyphs load) for the longest HUD line: "sandwiches made" and ten of the biggest digit.
+	Arena frame_arena{0};
+	// level_arena holds what lasts until the level changes (the free edge counters' transforms, on their way to the GPU);
+	// rebuild_board_counters resets it, and rebuild_board_tiles sizes it for the board.
+	Arena level_arena{0};
 
 	//------- game state -------
 
-	// avatar movement
-	// NOTE: Based on discussion from http://www.cplusplus.com/forum/general/29835/
-	const float max_velocity = 0.15f;
-    const float acceleration = 0.75f;
-    const float deceleration = 0.75f;
-
-    glm::vec3 avatar_location = glm::vec3(4,4,0);
-    glm::quat avatar_rotation = glm::quat();
-	float x_velocity = 0.0f; // tiles per second
-    float y_velocity = 0.0f;
-
-    struct {
-        float go_left = false;
-        float go_right = false;
-        float go_up = false;
-        float go_down = false;
-    } controls;
-
-    // board info
-    glm::uvec2 board_size = glm::uvec2(9,9);
-
-	struct Edge {
-	    uint8_t is_row = 0;
-	    uint8_t is_end = 0;
-	};
-    Edge top;
-    Edge bottom;
-    Edge left;
-    Edge right;
-	std::set<Edge *> edges;
-
-	struct CounterInfo{
-        Mesh *active;
-        Mesh *inactive;
-	    glm::uvec3 location = glm::uvec3(0,0,0);
-	    glm::quat rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(-90.0f)));
-	};
-	CounterInfo peanut;
-	CounterInfo bread;
-	CounterInfo jelly;
-	CounterInfo serve;
-    std::vector< CounterInfo * >key_counters;
+	//the simulation itself (no GL or audio; see GameState.hpp):
+	GameState state;
 
-    // level progression
-	uint8_t next_pickup = 0;
-	uint32_t num_sandwiches = 0;
+	//meshes for each of state.key_counters, when it is the next pickup (active) or not:
+	struct CounterMeshes {
+		Mesh *active;
+		Mesh *inactive;
+	};
+	std::vector< CounterMeshes > key_counter_meshes;
 
+	//note played for each step of state.level_progression:
 	std::vector< Sound * > notes;
-	std::vector< CounterInfo * > level_progression;
 
     //------- additional functions ------------
 
-    void generate_level();  //randomizes board
+    void rebuild_board_tiles(glm::uvec2 size); //re-uploads tile and stretched tile transforms to instances_vbo (and re-chunks the board)
+    void rebuild_board_counters(RenderSnapshot const &snapshot); //re-uploads free edge counter transforms to counter_instances_vbo
+    void rebuild_hud(uint32_t num_sandwiches); //re-lays-out hud for a count of sandwiches
 };
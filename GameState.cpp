@@ -0,0 +1,129 @@
+#include "GameState.hpp"
+
+#include "LevelPool.hpp"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+GameState::GameState(uint64_t seed_) {
+	key_counters = {&peanut, &bread, &jelly, &serve};
+
+	for (uint32_t i = 0; i < ProgressionLength; ++i) {
+		level_progression.emplace_back(key_counters[Progression[i]]);
+	}
+	set_seed(seed_);
+}
+
+GameState::~GameState() {
+}
+
+void GameState::set_seed(uint64_t seed_) {
+	seed = seed_;
+	random.reseed(seed);
+	//restart any pool from the new seed, too:
+	if (level_pool) {
+		level_pool.reset(new LevelPool(board_size, random, level_pool_capacity));
+	}
+	generate_level();
+}
+
+void GameState::set_board_size(glm::uvec2 size) {
+	if (size.x < MinBoardSize || size.y < MinBoardSize) {
+		throw std::runtime_error("boards must be at least " + std::to_string(MinBoardSize) + " cells on each side.");
+	}
+	board_size = size;
+
+	avatar_location = glm::vec3(size.x / 2, size.y / 2, 0);
+	previous_avatar_location = avatar_location;
+	x_velocity = 0.0f;
+	y_velocity = 0.0f;
+
+	//levels start over (rather than continuing from the current generator state), so a seed and board size
+	// always make the same levels, whether or not they come from a (restarted, resized) pool:
+	set_seed(seed);
+}
+
+void GameState::use_level_pool(uint32_t capacity) {
+	//the pool continues from the current generator state, so upcoming levels don't change:
+	level_pool_capacity = capacity;
+	level_pool.reset(new LevelPool(board_size, random, level_pool_capacity));
+}
+
+void GameState::generate_level() {
+	auto start = std::chrono::steady_clock::now();
+
+	auto next_layout = [this]() {
+		return level_pool ? level_pool->pop() : generate_layout(board_size, random, &layout_scratch);
+	};
+
+	glm::vec2 avatar = glm::vec2(avatar_location.x, avatar_location.y);
+	LevelLayout layout = next_layout();
+	for (uint32_t rejected = 0; rejected < MaxLayoutRejections && !layout_clear_of(layout, avatar); ++rejected) {
+		layout = next_layout();
+	}
+
+	for (uint32_t i = 0; i < KeyCounters; ++i) {
+		key_counters[i]->location = layout.locations[i];
+	}
+	mark_layout(layout, board_size, &counter_cells);
+
+	// Rotate the serve counter to point outwards
+	BoardEdge const &edge = BoardEdgeList[layout.edges[Serve]];
+	serve.rotation = glm::quat(glm::vec3(0.0f, 0.0f,
+			glm::radians((edge.is_row) * 90.0f + (edge.is_end) * 180.0f)));
+
+	++level_serial;
+	level_generation_ms = std::chrono::duration< float, std::milli >(std::chrono::steady_clock::now() - start).count();
+}
+
+void GameState::update(float elapsed) {
+    previous_avatar_location = avatar_location;
+    previous_avatar_rotation = avatar_rotation;
+    picked_up = -1;
+
+    // --------------- Progress -------------------------------
+    {
+    	CounterInfo *next_counter = level_progression[next_pickup];
+    	if (adjacent(next_counter->location, avatar_location, PickupLeeway)) {
+
+    		//let the owner react (e.g. Game plays this pickup's note):
+    		picked_up = next_pickup;
+
+    		++next_pickup;
+    		if (next_pickup == level_progression.size()) {
+	        	++num_sandwiches;
+	        	next_pickup = 0;
+	        	generate_level();
+    		}
+    	}
+    }
+
+	// --------------- Physics-based movement ---------------
+
+    // Default avatar orientation is (1,0); it faces whichever way was pressed last (in left, up, right, down order):
+    {
+        if (controls.go_left) {
+            avatar_rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(180.0f)));
+        }
+        if (controls.go_up) {
+            avatar_rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(90.0f)));
+        }
+        if (controls.go_right) {
+            avatar_rotation = glm::quat();
+        }
+        if (controls.go_down) {
+            avatar_rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(-90.0f)));
+        }
+
+        float push_x = (controls.go_right ? 1.0f : 0.0f) - (controls.go_left ? 1.0f : 0.0f);
+        float push_y = (controls.go_up ? 1.0f : 0.0f) - (controls.go_down ? 1.0f : 0.0f);
+        //(holding both keys of an axis cancels their pushes, but doesn't brake)
+        step_avatar_axis(&avatar_location.x, &x_velocity, push_x, elapsed, board_size.x, controls.go_left && controls.go_right);
+        step_avatar_axis(&avatar_location.y, &y_velocity, push_y, elapsed, board_size.y, controls.go_up && controls.go_down);
+    }
+}
+
+bool adjacent(glm::vec3 locationA, glm::vec3 locationB, float leeway) {
+	return adjacent_xy(locationA.x, locationA.y, locationB.x, locationB.y, leeway);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "game_rules.hpp"
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+struct LevelPool; //LevelPool.hpp
+
+// The 'GameState' struct holds the simulation -- avatar, board, and level progression.
+// It uses neither OpenGL nor SDL, so it can be stepped without a window (see bench.cpp);
+// Game owns one and draws it.
+
+struct GameState {
+	//'seed' determines the sequence of levels:
+	explicit GameState(uint64_t seed);
+	~GameState();
+
+	//key_counters and level_progression point into the state itself, so it can't be copied:
+	GameState(GameState const &) = delete;
+	GameState &operator=(GameState const &) = delete;
+
+	//advance the simulation by 'elapsed' seconds:
+	void update(float elapsed);
+
+	//randomizes board (taking the next layout that doesn't crowd the avatar):
+	void generate_level();
+
+	//generate upcoming layouts on a background thread, keeping up to 'capacity' ready:
+	// (levels come out exactly as they would have without the pool)
+	void use_level_pool(uint32_t capacity = 16);
+
+	//restart the level generator from 'seed' and generate a new level from it:
+	// (so a given seed and sequence of controls always plays out the same way)
+	void set_seed(uint64_t seed);
+	uint64_t get_seed() const { return seed; }
+
+	//resize the board (at least MinBoardSize cells each way), recenter the avatar, and restart the levels from the seed:
+	void set_board_size(glm::uvec2 size);
+
+	// avatar movement (tuning constants and stepping are in game_rules.hpp)
+	glm::vec3 avatar_location = glm::vec3(4,4,0);
+	glm::quat avatar_rotation = glm::quat();
+	float x_velocity = 0.0f; // tiles per second
+	float y_velocity = 0.0f;
+
+	//avatar state as of the start of the latest update, for interpolating draws between ticks:
+	glm::vec3 previous_avatar_location = avatar_location;
+	glm::quat previous_avatar_rotation = avatar_rotation;
+
+	//held controls (0 or 1):
+	struct {
+		float go_left = false;
+		float go_right = false;
+		float go_up = false;
+		float go_down = false;
+	} controls;
+
+	// board info
+	glm::uvec2 board_size = glm::uvec2(9,9);
+
+	struct CounterInfo {
+		glm::uvec3 location = glm::uvec3(0,0,0);
+		glm::quat rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(-90.0f)));
+	};
+	CounterInfo peanut;
+	CounterInfo bread;
+	CounterInfo jelly;
+	CounterInfo serve;
+	std::vector< CounterInfo * > key_counters; //in game_rules.hpp's Peanut, Bread, Jelly, Serve order
+
+	//which cells hold a key counter, as of the latest generate_level():
+	OccupancyGrid counter_cells;
+
+	// level progression
+	uint8_t next_pickup = 0;
+	uint32_t num_sandwiches = 0;
+
+	std::vector< CounterInfo * > level_progression;
+
+	//level generator, and the seed it was last started from:
+	uint64_t seed = 0;
+	Pcg32 random;
+	OccupancyGrid layout_scratch; //for generate_layout
+
+	//if set, layouts come from here instead of being generated by generate_level():
+	std::unique_ptr< LevelPool > level_pool;
+	uint32_t level_pool_capacity = 0;
+
+	//incremented by every generate_level(), so observers can tell when the board changed:
+	uint32_t level_serial = 0;
+	//how long the latest generate_level() took, in milliseconds (for metrics; it doesn't affect the simulation):
+	float level_generation_ms = 0.0f;
+
+	//set by update(): the index into level_progression picked up during that update, or -1 if none:
+	int32_t picked_up = -1;
+};
+
+//adjacent_xy (game_rules.hpp) for locations:
+bool adjacent(glm::vec3 locationA, glm::vec3 locationB, float leeway);
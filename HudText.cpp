@@ -0,0 +1,74 @@
+#include "HudText.hpp"
+
+#include <cstddef>
+#include <stdexcept>
+
+HudText::HudText(GLuint Position_vec4, GLuint Normal_vec3, GLuint Color_vec4) {
+	glGenBuffers(1, &vbo);
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glVertexAttribPointer(Position_vec4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, Position));
+	glEnableVertexAttribArray(Position_vec4);
+	if (Normal_vec3 != -1U) {
+		glVertexAttribPointer(Normal_vec3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, Normal));
+		glEnableVertexAttribArray(Normal_vec3);
+	}
+	if (Color_vec4 != -1U) {
+		glVertexAttribPointer(Color_vec4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, Color));
+		glEnableVertexAttribArray(Color_vec4);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+HudText::~HudText() {
+	glDeleteVertexArrays(1, &vao);
+	vao = -1U;
+
+	glDeleteBuffers(1, &vbo);
+	vbo = -1U;
+}
+
+uint32_t HudText::add_glyph(std::vector< Vertex > const &vertices) {
+	Glyph glyph;
+	glyph.first = uint32_t(glyph_vertices.size());
+	glyph.count = uint32_t(vertices.size());
+	glyph_vertices.insert(glyph_vertices.end(), vertices.begin(), vertices.end());
+	glyphs.emplace_back(glyph);
+	return uint32_t(glyphs.size() - 1);
+}
+
+void HudText::place(uint32_t glyph, glm::vec3 offset, ArenaVector< Vertex > *line) const {
+	if (glyph >= glyphs.size()) {
+		throw std::runtime_error("HudText::place called with an unknown glyph.");
+	}
+	Glyph const &g = glyphs[glyph];
+	for (uint32_t i = g.first; i < g.first + g.count; ++i) {
+		Vertex v = glyph_vertices[i];
+		v.Position += offset;
+		line->emplace_back(v);
+	}
+}
+
+void HudText::upload(ArenaVector< Vertex > const &line) {
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	uploaded_count = GLsizei(line.size());
+	if (uploaded_count > vbo_capacity) {
+		//grow (to twice what's needed, so a counter gaining digits doesn't reallocate every time):
+		vbo_capacity = 2 * uploaded_count;
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vbo_capacity, NULL, GL_DYNAMIC_DRAW);
+	}
+	if (uploaded_count > 0) {
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vertex) * uploaded_count, line.data());
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void HudText::draw() const {
+	if (uploaded_count == 0) return;
+	glBindVertexArray(vao);
+	glDrawArrays(GL_TRIANGLES, 0, uploaded_count);
+	glBindVertexArray(0);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "GL.hpp"
+#include "Arena.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+//HudText draws a line of text, laid out from glyph meshes, with a single draw call.
+// The line is laid out by place() in a caller's (frame arena) vector and baked into its own vertex buffer by upload(),
+// so the text only costs CPU time (and a buffer update) when it changes, and neither that nor draw() touches the heap.
+struct HudText {
+	//glyph vertices, as unindexed triangles (the same layout as 'dat0' mesh blobs):
+	struct Vertex {
+		glm::vec3 Position;
+		glm::vec3 Normal;
+		glm::u8vec4 Color;
+	};
+	static_assert(sizeof(Vertex) == 28, "Vertex should be packed.");
+
+	//attribute locations of the program that will draw the text:
+	HudText(GLuint Position_vec4, GLuint Normal_vec3, GLuint Color_vec4);
+	~HudText();
+
+	HudText(HudText const &) = delete;
+	HudText &operator=(HudText const &) = delete;
+
+	//add a glyph made of 'vertices'; returns its index for use with place():
+	uint32_t add_glyph(std::vector< Vertex > const &vertices);
+
+	//append a copy of 'glyph', with 'offset' added to its vertex positions, to the line being laid out:
+	void place(uint32_t glyph, glm::vec3 offset, ArenaVector< Vertex > *line) const;
+
+	//copy a laid-out line to the vertex buffer:
+	void upload(ArenaVector< Vertex > const &line);
+
+	//draw the last uploaded line with the currently bound program:
+	void draw() const;
+
+	//glyph shapes, as ranges of glyph_vertices:
+	struct Glyph {
+		uint32_t first = 0;
+		uint32_t count = 0;
+	};
+	std::vector< Glyph > glyphs;
+	std::vector< Vertex > glyph_vertices;
+
+	GLuint vbo = -1U;
+	GLuint vao = -1U;
+	GLsizei vbo_capacity = 0; //in vertices
+	GLsizei uploaded_count = 0;
+};
@@ -0,0 +1,128 @@
+#include "InputLog.hpp"
+
+#include "GameState.hpp"
+#include "read_chunk.hpp"
+
+#include <fstream>
+#include <stdexcept>
+
+//saved as an 'inp0' chunk holding one of these, then a 'ctl0' chunk of InputLog::changes:
+struct InputLogHeader {
+	uint64_t seed;
+	uint64_t ticks;
+	float tick_rate;
+	uint32_t final_sandwiches;
+	uint32_t board_width;
+	uint32_t board_height;
+};
+static_assert(sizeof(InputLogHeader) == 32, "InputLogHeader should be packed.");
+
+uint8_t InputLog::controls_mask(GameState const &state) {
+	return (state.controls.go_left ? Left : 0)
+	     | (state.controls.go_right ? Right : 0)
+	     | (state.controls.go_up ? Up : 0)
+	     | (state.controls.go_down ? Down : 0);
+}
+
+void InputLog::set_controls(GameState *state, uint8_t mask) {
+	state->controls.go_left = (mask & Left) != 0;
+	state->controls.go_right = (mask & Right) != 0;
+	state->controls.go_up = (mask & Up) != 0;
+	state->controls.go_down = (mask & Down) != 0;
+}
+
+void InputLog::record(uint8_t mask) {
+	//(nothing is held before the first tick)
+	if (mask != recorded_mask) {
+		uint64_t value = ((ticks - recorded_change_tick) << 4) | mask;
+		do {
+			changes.emplace_back(uint8_t((value & 0x7f) | (value >= 0x80 ? 0x80 : 0)));
+			value >>= 7;
+		} while (value != 0);
+		recorded_mask = mask;
+		recorded_change_tick = ticks;
+	}
+	++ticks;
+}
+
+void InputLog::save(std::string const &filename) const {
+	std::ofstream file(filename, std::ios::binary);
+	InputLogHeader header;
+	header.seed = seed;
+	header.ticks = ticks;
+	header.tick_rate = tick_rate;
+	header.final_sandwiches = final_sandwiches;
+	header.board_width = board_width;
+	header.board_height = board_height;
+	write_chunk(file, "inp0", std::vector< InputLogHeader >(1, header));
+	write_chunk(file, "ctl0", changes);
+	if (!file) {
+		throw std::runtime_error("failed to write input log '" + filename + "'.");
+	}
+}
+
+void InputLog::load(std::string const &filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("failed to open input log '" + filename + "'.");
+	}
+	std::vector< InputLogHeader > header;
+	read_chunk(file, "inp0", &header);
+	if (header.size() != 1) {
+		throw std::runtime_error("input log '" + filename + "' should have exactly one header.");
+	}
+	read_chunk(file, "ctl0", &changes);
+
+	seed = header[0].seed;
+	ticks = header[0].ticks;
+	tick_rate = header[0].tick_rate;
+	final_sandwiches = header[0].final_sandwiches;
+	board_width = header[0].board_width;
+	board_height = header[0].board_height;
+	if (!(tick_rate > 0.0f)) {
+		throw std::runtime_error("input log '" + filename + "' has an invalid tick rate.");
+	}
+
+	//(so record() could continue the log)
+	recorded_mask = 0;
+	recorded_change_tick = 0;
+	Player player(*this);
+	while (player.have_change) {
+		recorded_mask = player.change_mask;
+		recorded_change_tick = player.change_tick;
+		player.read_change();
+	}
+}
+
+InputLog::Player::Player(InputLog const &log_) : log(log_) {
+	read_change();
+}
+
+void InputLog::Player::read_change() {
+	have_change = false;
+	if (offset >= log.changes.size()) return;
+
+	uint64_t value = 0;
+	for (uint32_t shift = 0; ; shift += 7) {
+		if (offset >= log.changes.size() || shift > 63) {
+			throw std::runtime_error("truncated or corrupt change in input log.");
+		}
+		uint8_t byte = log.changes[offset++];
+		value |= uint64_t(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) break;
+	}
+	have_change = true;
+	change_tick += value >> 4;
+	change_mask = uint8_t(value & 0xf);
+}
+
+bool InputLog::Player::next(uint8_t *mask_) {
+	if (tick >= log.ticks) return false;
+	while (have_change && change_tick <= tick) {
+		mask = change_mask;
+		read_change();
+	}
+	*mask_ = mask;
+	++tick;
+	return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct GameState; //GameState.hpp
+
+//InputLog records the controls held during each tick of a session, so the session can be replayed exactly:
+// a GameState started from the same seed and board size, and stepped at the same tick rate with the same controls plays out identically.
+//Only changes are stored: each is a varint of (ticks since the previous change << 4 | controls mask),
+// so a held key costs nothing, and a typical change fits in one or two bytes.
+struct InputLog {
+	//controls, as bits of a mask:
+	enum : uint8_t { Left = 1, Right = 2, Up = 4, Down = 8 };
+	static uint8_t controls_mask(GameState const &state);
+	static void set_controls(GameState *state, uint8_t mask);
+
+	uint64_t seed = 0; //level seed of the recorded session
+	uint32_t board_width = 9; //GameState::board_size of the recorded session
+	uint32_t board_height = 9;
+	float tick_rate = 60.0f; //ticks per simulated second
+	uint64_t ticks = 0; //number of ticks recorded
+	uint32_t final_sandwiches = 0; //the state at the end of the recording, to check replays against
+	std::vector< uint8_t > changes; //encoded as above
+
+	//append one tick, holding 'mask':
+	void record(uint8_t mask);
+
+	//save to, or replace this log with one loaded from, 'filename'; both throw on failure:
+	void save(std::string const &filename) const;
+	void load(std::string const &filename);
+
+	//Player returns the recorded controls tick by tick:
+	struct Player {
+		explicit Player(InputLog const &log);
+		//the controls held during the next tick, or false once all recorded ticks are played:
+		bool next(uint8_t *mask);
+
+		InputLog const &log;
+		uint64_t tick = 0; //ticks played so far
+		size_t offset = 0; //into log.changes
+		uint8_t mask = 0;
+		bool have_change = false; //if false, no more changes
+		uint64_t change_tick = 0; //tick at which the next change takes effect
+		uint8_t change_mask = 0;
+
+		void read_change();
+	};
+
+	//------- recording state -------
+	uint8_t recorded_mask = 0;
+	uint64_t recorded_change_tick = 0;
+};
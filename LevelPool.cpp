@@ -0,0 +1,48 @@
+#include "LevelPool.hpp"
+
+#include "occupancy_grid.hpp"
+
+LevelPool::LevelPool(glm::uvec2 board_size_, Pcg32 const &random_, uint32_t capacity_)
+	: board_size(board_size_), random(random_), capacity(capacity_ ? capacity_ : 1), ready(capacity), thread(&LevelPool::worker, this) {
+}
+
+LevelPool::~LevelPool() {
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		quit = true;
+	}
+	not_full.notify_all();
+	thread.join();
+}
+
+LevelLayout LevelPool::pop() {
+	std::unique_lock< std::mutex > lock(mutex);
+	not_empty.wait(lock, [this](){ return ready_count > 0; });
+	LevelLayout layout = ready[ready_first];
+	ready_first = (ready_first + 1) % capacity;
+	--ready_count;
+	lock.unlock();
+	not_full.notify_one();
+	return layout;
+}
+
+void LevelPool::worker() {
+	OccupancyGrid scratch;
+	while (true) {
+		{ //wait for room:
+			std::unique_lock< std::mutex > lock(mutex);
+			not_full.wait(lock, [this](){ return quit || ready_count < capacity; });
+			if (quit) return;
+		}
+
+		//generate outside the lock, so pop() never waits on generation when layouts are ready:
+		LevelLayout layout = generate_layout(board_size, random, &scratch);
+
+		{
+			std::lock_guard< std::mutex > lock(mutex);
+			ready[(ready_first + ready_count) % capacity] = layout;
+			++ready_count;
+		}
+		not_empty.notify_one();
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "game_rules.hpp"
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The 'LevelPool' struct generates level layouts ahead of time on a worker thread,
+// so starting a new level is just taking the next one off a queue.
+// Layouts come out in exactly the order 'random' would have generated them inline,
+// so using a pool doesn't change which levels a seed produces.
+// At most 'capacity' layouts are kept waiting, in a ring allocated up front, so the pool never allocates once running.
+
+struct LevelPool {
+	//the pool draws from its own copy of 'random':
+	LevelPool(glm::uvec2 board_size, Pcg32 const &random, uint32_t capacity = 16);
+	~LevelPool();
+
+	LevelPool(LevelPool const &) = delete;
+	LevelPool &operator=(LevelPool const &) = delete;
+
+	//take the next layout (waits for the worker if none are ready yet):
+	LevelLayout pop();
+
+private:
+	void worker();
+
+	glm::uvec2 board_size;
+	Pcg32 random; //only used by the worker
+	uint32_t capacity;
+
+	std::mutex mutex; //guards ready, ready_first, ready_count, and quit
+	std::condition_variable not_empty;
+	std::condition_variable not_full;
+	std::vector< LevelLayout > ready; //ring of 'capacity' layouts; the waiting ones start at ready_first
+	uint32_t ready_first = 0;
+	uint32_t ready_count = 0;
+	bool quit = false;
+
+	std::thread thread; //last, so everything above exists before the worker starts
+};
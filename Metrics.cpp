@@ -0,0 +1,183 @@
+#include "Metrics.hpp"
+
+#if defined(_WIN32)
+//(keep windows.h, which winsock2.h pulls in, from defining min and max macros that break std::min and std::max)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(_WIN32)
+static void close_socket(uintptr_t socket) { closesocket(SOCKET(socket)); }
+#else
+static void close_socket(uintptr_t socket) { close(int(socket)); }
+#endif
+
+Metrics::Metrics(std::string const &address, std::string const &prefix_, float interval_)
+	: prefix(prefix_), interval(std::chrono::duration_cast< Clock::duration >(std::chrono::duration< float >(interval_))) {
+	size_t colon = address.rfind(':');
+	if (colon == std::string::npos || colon == 0 || colon + 1 == address.size()) {
+		throw std::runtime_error("metrics address '" + address + "' should look like '<host>:<port>'.");
+	}
+	std::string host = address.substr(0, colon);
+	std::string port = address.substr(colon + 1);
+
+	#if defined(_WIN32)
+	WSADATA wsa;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+		throw std::runtime_error("failed to start winsock for metrics.");
+	}
+	#endif
+
+	addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	addrinfo *found = nullptr;
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0 || !found) {
+		throw std::runtime_error("failed to resolve metrics address '" + address + "'.");
+	}
+
+	//(UDP 'connect' just fixes the destination, so sends don't need an address)
+	for (addrinfo *a = found; a; a = a->ai_next) {
+		#if defined(_WIN32)
+		SOCKET s = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (s == INVALID_SOCKET) continue;
+		u_long non_blocking = 1;
+		if (ioctlsocket(s, FIONBIO, &non_blocking) != 0 || connect(s, a->ai_addr, int(a->ai_addrlen)) != 0) {
+			closesocket(s);
+			continue;
+		}
+		#else
+		int s = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (s < 0) continue;
+		if (fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK) != 0 || connect(s, a->ai_addr, a->ai_addrlen) != 0) {
+			close(s);
+			continue;
+		}
+		#endif
+		socket = uintptr_t(s);
+		break;
+	}
+	freeaddrinfo(found);
+	if (socket == ~uintptr_t(0)) {
+		throw std::runtime_error("failed to open a socket to metrics address '" + address + "'.");
+	}
+
+	thread = std::thread(&Metrics::reporter, this);
+}
+
+Metrics::~Metrics() {
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		quit = true;
+	}
+	quit_cv.notify_all();
+	thread.join();
+
+	close_socket(socket);
+	socket = ~uintptr_t(0);
+	#if defined(_WIN32)
+	WSACleanup();
+	#endif
+
+	if (dropped) {
+		std::cerr << "NOTE: " << dropped << " metrics datagrams couldn't be sent." << std::endl;
+	}
+}
+
+void Metrics::reporter() {
+	Clock::time_point last = Clock::now();
+	std::unique_lock< std::mutex > lock(mutex);
+	while (true) {
+		bool stopping = quit_cv.wait_until(lock, last + interval, [this](){ return quit; });
+		lock.unlock();
+		Clock::time_point now = Clock::now();
+		report(std::chrono::duration< float >(now - last).count());
+		last = now;
+		if (stopping) return;
+		lock.lock();
+	}
+}
+
+void Metrics::report(float seconds) {
+	std::ostringstream lines;
+	auto line = [&](std::string const &name, double value, char const *type) {
+		lines << prefix << '.' << name << ':' << value << '|' << type << '\n';
+	};
+
+	//histograms are taken a bucket at a time, so a sample landing mid-snapshot is counted in this snapshot or the next, never lost:
+	auto histogram = [&](std::string const &name, Histogram &h) {
+		uint32_t counts[Histogram::Buckets];
+		uint64_t samples = 0;
+		for (uint32_t b = 0; b < Histogram::Buckets; ++b) {
+			counts[b] = h.counts[b].exchange(0, std::memory_order_relaxed);
+			samples += counts[b];
+		}
+		line(name + ".count", double(samples), "c");
+		if (samples == 0) return;
+		//(upper edge of the bucket holding each percentile, as Profiler::Histogram reports them; or the value itself, for whole numbers)
+		auto percentile = [&](double p) {
+			uint64_t target = std::max(uint64_t(1), uint64_t(std::ceil(p * double(samples))));
+			uint64_t seen = 0;
+			uint32_t b = 0;
+			for (; b + 1 < Histogram::Buckets; ++b) {
+				seen += counts[b];
+				if (seen >= target) break;
+			}
+			return double(h.whole_numbers ? b : b + 1) * h.bucket_width;
+		};
+		line(name + ".p50", percentile(0.5), "g");
+		line(name + ".p90", percentile(0.9), "g");
+		line(name + ".p99", percentile(0.99), "g");
+		line(name + ".max", percentile(1.0), "g");
+	};
+
+	histogram("frame_ms", frame_ms);
+	histogram("update_ms", update_ms);
+	histogram("draw_calls", draw_calls);
+	histogram("level_generation_ms", level_generation_ms);
+
+	uint64_t made = sandwiches.exchange(0, std::memory_order_relaxed);
+	line("sandwiches", double(made), "c");
+	if (seconds > 0.0f) line("sandwiches_per_minute", double(made) * 60.0 / seconds, "g");
+
+	//split into datagrams that fit in a typical MTU (statsd takes newline-separated metrics per datagram):
+	std::string all = lines.str();
+	size_t const MaxDatagram = 1400;
+	size_t begin = 0;
+	while (begin < all.size()) {
+		size_t end = begin;
+		while (end < all.size()) {
+			size_t next = all.find('\n', end) + 1;
+			if (next - begin > MaxDatagram && end > begin) break;
+			end = next;
+		}
+		send(all.substr(begin, end - begin));
+		begin = end;
+	}
+}
+
+void Metrics::send(std::string const &datagram) {
+	#if defined(_WIN32)
+	int sent = ::send(SOCKET(socket), datagram.data(), int(datagram.size()), 0);
+	#else
+	ssize_t sent = ::send(int(socket), datagram.data(), datagram.size(), 0);
+	#endif
+	//(a full buffer, or nobody listening, costs this snapshot; the next one starts fresh)
+	if (sent != decltype(sent)(datagram.size())) ++dropped;
+}
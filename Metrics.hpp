@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+//Metrics keeps fleet telemetry -- histograms of frame time, update time, draw calls, and level generation time,
+// plus gameplay counters -- and sends a snapshot of it every 'interval' seconds to a statsd server over UDP
+// (main's --metrics <host>:<port>), as gauges of each histogram's p50/p90/p99/max and counts since the last snapshot.
+// Recording is lock-free and allocation-free: a histogram sample or a counter bump is one relaxed atomic increment,
+// so any thread can record; a background thread does the rest. Sends never block (a datagram that can't go out right away is dropped).
+struct Metrics {
+	//fixed-size histogram whose buckets can be bumped from any thread:
+	struct Histogram {
+		static constexpr uint32_t Buckets = 1000; //the last bucket holds everything larger
+		//'whole_numbers' histograms (of counts, with a bucket_width of 1) report exact values rather than bucket upper edges:
+		explicit Histogram(float bucket_width_, bool whole_numbers_ = false) : bucket_width(bucket_width_), whole_numbers(whole_numbers_) { }
+		void add(float value) {
+			if (!(value >= 0.0f)) return;
+			uint32_t bucket = (value < Buckets * bucket_width ? uint32_t(value / bucket_width) : Buckets - 1);
+			counts[bucket].fetch_add(1, std::memory_order_relaxed);
+		}
+		float const bucket_width;
+		bool const whole_numbers;
+		std::atomic< uint32_t > counts[Buckets] = {};
+	};
+
+	//'address' is <host>:<port>; every metric is named '<prefix>.<metric>'; throws if the address can't be resolved:
+	Metrics(std::string const &address, std::string const &prefix, float interval);
+	//sends a last snapshot:
+	~Metrics();
+
+	Metrics(Metrics const &) = delete;
+	Metrics &operator=(Metrics const &) = delete;
+
+	//------- recorded by main -------
+	Histogram frame_ms{0.1f}; //from one frame's draw to the next's
+	Histogram update_ms{0.1f}; //simulation time per frame
+	Histogram draw_calls{1.0f, true}; //per frame
+
+	//------- recorded by Game -------
+	Histogram level_generation_ms{0.01f};
+	std::atomic< uint64_t > sandwiches{0};
+
+	//------- internals -------
+
+	typedef std::chrono::steady_clock Clock;
+
+	std::string prefix;
+	Clock::duration interval;
+	uintptr_t socket = ~uintptr_t(0); //SOCKET on windows, a file descriptor elsewhere; connected, so send() needs no address
+	uint64_t dropped = 0; //datagrams that couldn't be sent
+
+	std::mutex mutex; //guards quit
+	std::condition_variable quit_cv;
+	bool quit = false;
+
+	//take (and clear) everything recorded since the last snapshot, and send it:
+	void report(float seconds);
+	void send(std::string const &datagram);
+	void reporter();
+
+	std::thread thread; //last, so everything above exists before the reporter starts
+};
@@ -0,0 +1,184 @@
+#include "Profiler.hpp"
+
+#include "Arena.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+static char const *PhaseNames[Profiler::Phases] = { "events", "update", "draw", "swap" };
+static char const *PassNames[Profiler::Passes] = { "gpu_world", "gpu_hud" };
+
+Profiler::Profiler(std::string const &csv_path) {
+	glGenQueries(FramesInFlight * Passes, &queries[0][0]);
+
+	if (!csv_path.empty()) {
+		csv.open(csv_path);
+		if (!csv) {
+			throw std::runtime_error("failed to open profile log '" + csv_path + "'.");
+		}
+		csv << "frame,total_ms";
+		for (uint32_t p = 0; p < Phases; ++p) csv << ',' << PhaseNames[p] << "_ms";
+		for (uint32_t p = 0; p < Passes; ++p) csv << ',' << PassNames[p] << "_ms";
+		csv << ",input_ms,allocations\n";
+	}
+}
+
+Profiler::~Profiler() {
+	finish();
+	glDeleteQueries(FramesInFlight * Passes, &queries[0][0]);
+}
+
+void Profiler::begin_frame() {
+	Clock::time_point now = Clock::now();
+	uint64_t now_allocations = heap_allocations();
+	uint64_t index = 0;
+	if (started) {
+		frame.total = std::chrono::duration< float, std::milli >(now - frame_start).count();
+		frame.allocations = now_allocations - frame_start_allocations;
+		end_frame();
+		index = frame.index + 1;
+	}
+	started = true;
+	frame_start = now;
+	frame_start_allocations = now_allocations;
+	frame = FrameSample();
+	frame.index = index;
+
+	//this frame's queries reuse the slot of the frame FramesInFlight ago:
+	if (index >= FramesInFlight) {
+		retire(index % FramesInFlight, false);
+	}
+}
+
+void Profiler::gpu_begin(Pass pass) {
+	if (active_pass >= 0) {
+		throw std::runtime_error("Profiler::gpu_begin called inside another pass.");
+	}
+	uint32_t slot = frame.index % FramesInFlight;
+	glBeginQuery(GL_TIME_ELAPSED, queries[slot][pass]);
+	issued[slot][pass] = true;
+	active_pass = int32_t(pass);
+}
+
+void Profiler::input_latency(float ms) {
+	frame.input = ms;
+}
+
+void Profiler::gpu_end() {
+	if (active_pass < 0) {
+		throw std::runtime_error("Profiler::gpu_end called outside of a pass.");
+	}
+	glEndQuery(GL_TIME_ELAPSED);
+	active_pass = -1;
+}
+
+void Profiler::end_frame() {
+	pending[frame.index % FramesInFlight] = frame;
+}
+
+void Profiler::retire(uint32_t slot, bool wait) {
+	FrameSample &sample = pending[slot];
+
+	for (uint32_t p = 0; p < Passes; ++p) {
+		sample.gpu[p] = -1.0f;
+		if (!issued[slot][p]) continue;
+		issued[slot][p] = false;
+
+		GLint available = GL_TRUE;
+		if (!wait) {
+			glGetQueryObjectiv(queries[slot][p], GL_QUERY_RESULT_AVAILABLE, &available);
+		}
+		if (available) {
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(queries[slot][p], GL_QUERY_RESULT, &ns);
+			sample.gpu[p] = float(double(ns) * 1e-6);
+			gpu_histograms[p].add(sample.gpu[p]);
+		} else {
+			//the slot is about to be reused, so this result is lost (the GPU is more than FramesInFlight behind):
+			++gpu_missed;
+		}
+	}
+
+	total_histogram.add(sample.total);
+	if (sample.input >= 0.0f) input_histogram.add(sample.input);
+	if (sample.allocations) {
+		++allocating_frames;
+		last_allocating_frame = std::max(last_allocating_frame, sample.index);
+		allocations += sample.allocations;
+	}
+	for (uint32_t p = 0; p < Phases; ++p) {
+		cpu_histograms[p].add(sample.cpu[p]);
+	}
+
+	if (csv.is_open()) {
+		csv << sample.index << ',' << sample.total;
+		for (uint32_t p = 0; p < Phases; ++p) csv << ',' << sample.cpu[p];
+		for (uint32_t p = 0; p < Passes; ++p) csv << ',' << sample.gpu[p];
+		csv << ',' << sample.input << ',' << sample.allocations << '\n';
+	}
+}
+
+void Profiler::finish() {
+	if (finished) return;
+	finished = true;
+	if (!started) return;
+
+	if (active_pass >= 0) gpu_end();
+	frame.total = std::chrono::duration< float, std::milli >(Clock::now() - frame_start).count();
+	frame.allocations = heap_allocations() - frame_start_allocations;
+	end_frame();
+
+	//the last (up to) FramesInFlight frames are still pending; wait for their results:
+	uint64_t last = frame.index;
+	uint64_t first = (last + 1 >= FramesInFlight ? last + 1 - FramesInFlight : 0);
+	for (uint64_t i = first; i <= last; ++i) {
+		retire(uint32_t(i % FramesInFlight), true);
+	}
+	if (csv.is_open()) csv.flush();
+
+	std::cout << "Frame times over " << total_histogram.samples << " frames (ms):\n";
+	std::cout << std::setw(12) << "" << std::setw(9) << "p50" << std::setw(9) << "p90" << std::setw(9) << "p99" << std::setw(9) << "max" << "\n";
+	auto row = [](char const *name, Histogram const &h) {
+		std::cout << std::setw(12) << name << std::fixed << std::setprecision(2)
+			<< std::setw(9) << h.percentile(0.5f)
+			<< std::setw(9) << h.percentile(0.9f)
+			<< std::setw(9) << h.percentile(0.99f)
+			<< std::setw(9) << h.max << "\n";
+	};
+	row("total", total_histogram);
+	for (uint32_t p = 0; p < Phases; ++p) row(PhaseNames[p], cpu_histograms[p]);
+	for (uint32_t p = 0; p < Passes; ++p) row(PassNames[p], gpu_histograms[p]);
+	if (input_histogram.samples) row("input", input_histogram);
+	//(loading allocates, so what matters is whether frames stop allocating once play is underway)
+	std::cout << allocations << " heap allocations in " << allocating_frames << " of " << total_histogram.samples << " frames";
+	if (allocating_frames) std::cout << ", the last in frame " << last_allocating_frame;
+	std::cout << "\n";
+	if (gpu_missed) {
+		std::cout << "(" << gpu_missed << " GPU timings arrived too late to record)\n";
+	}
+	std::cout.flush();
+}
+
+void Profiler::Histogram::add(float ms) {
+	if (!(ms >= 0.0f)) return;
+	uint32_t bucket = std::min(uint32_t(ms / BucketWidth), Buckets - 1);
+	++counts[bucket];
+	++samples;
+	max = std::max(max, ms);
+}
+
+float Profiler::Histogram::percentile(float p) const {
+	if (samples == 0) return 0.0f;
+	uint64_t target = std::max(uint64_t(1), uint64_t(std::ceil(double(p) * double(samples))));
+	uint64_t seen = 0;
+	for (uint32_t b = 0; b < Buckets; ++b) {
+		seen += counts[b];
+		if (seen >= target) {
+			return std::min((b + 1) * BucketWidth, max);
+		}
+	}
+	return max;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+//Profiler times each phase of the main loop on the CPU, and each draw pass on the GPU (with GL_TIME_ELAPSED queries),
+// plus input-to-photon time (key event to the swap of the first frame showing it) when main reports it,
+// and heap allocations (as counted by Arena.cpp's operator new) made by each frame,
+// writing one CSV row per frame (if given a path) and printing frame time percentiles when finished.
+// GPU results are read FramesInFlight frames late, and only once available, so profiling never stalls the pipeline.
+// Keeping statistics is allocation-free per frame, so it can stay on in long sessions.
+struct Profiler {
+	typedef std::chrono::high_resolution_clock Clock;
+
+	//main loop phases, timed on the CPU with Scope:
+	enum Phase : uint32_t { Events = 0, Update = 1, Draw = 2, Swap = 3, Phases = 4 };
+	//draw passes, timed on the GPU with gpu_begin / gpu_end:
+	enum Pass : uint32_t { WorldPass = 0, HudPass = 1, Passes = 2 };
+
+	//'csv_path' may be empty to skip the per-frame log:
+	explicit Profiler(std::string const &csv_path);
+	~Profiler();
+
+	Profiler(Profiler const &) = delete;
+	Profiler &operator=(Profiler const &) = delete;
+
+	//call at the start of every pass through the main loop (ends the previous frame):
+	void begin_frame();
+
+	//times a main loop phase for as long as it is in scope (does nothing if 'profiler' is null):
+	struct Scope {
+		Scope(Profiler *profiler_, Phase phase_) : profiler(profiler_), phase(phase_) {
+			if (profiler) start = Clock::now();
+		}
+		~Scope() {
+			if (profiler) profiler->frame.cpu[phase] += std::chrono::duration< float, std::milli >(Clock::now() - start).count();
+		}
+		Profiler *profiler;
+		Phase phase;
+		Clock::time_point start;
+	};
+
+	//record the input-to-photon time of input the frame being timed shows:
+	void input_latency(float ms);
+
+	//bracket a draw pass's GL commands (passes may not overlap):
+	void gpu_begin(Pass pass);
+	void gpu_end();
+
+	//read back outstanding GPU timings, log the last frame, and print percentiles:
+	// (called by the destructor if not before; either way, the GL context must still exist)
+	void finish();
+
+	//------- internals -------
+
+	//milliseconds spent in each phase and pass of one frame (gpu is -1 for passes without a result):
+	struct FrameSample {
+		uint64_t index = 0;
+		float total = 0.0f;
+		float cpu[Phases] = {};
+		float gpu[Passes] = {};
+		float input = -1.0f; //input-to-photon time, for frames that showed new input
+		uint64_t allocations = 0; //heap allocations on any thread (not milliseconds)
+	};
+
+	//fixed-size histogram of millisecond timings, for percentiles without storing every frame:
+	struct Histogram {
+		static constexpr uint32_t Buckets = 1000;
+		static constexpr float BucketWidth = 0.1f; //ms; the last bucket holds everything slower
+		uint32_t counts[Buckets] = {};
+		uint64_t samples = 0;
+		float max = 0.0f;
+		void add(float ms);
+		float percentile(float p) const; //upper edge of the bucket holding the p'th percentile
+	};
+
+	//frames whose queries are still in flight, oldest first (ring indexed by frame index):
+	static constexpr uint32_t FramesInFlight = 4;
+	FrameSample pending[FramesInFlight];
+	GLuint queries[FramesInFlight][Passes];
+	bool issued[FramesInFlight][Passes] = {};
+
+	FrameSample frame; //the frame being timed
+	Clock::time_point frame_start;
+	uint64_t frame_start_allocations = 0;
+	bool started = false;
+	bool finished = false;
+	int32_t active_pass = -1;
+
+	Histogram total_histogram;
+	Histogram cpu_histograms[Phases];
+	Histogram gpu_histograms[Passes];
+	Histogram input_histogram;
+	uint64_t gpu_missed = 0; //queries overwritten before their results arrived
+	uint64_t allocating_frames = 0; //frames that made any heap allocations
+	uint64_t last_allocating_frame = 0;
+	uint64_t allocations = 0; //over all frames
+
+	std::ofstream csv;
+
+	//move 'frame' into the ring, retiring the frame it replaces:
+	void end_frame();
+	//read the ring slot's queries (if 'wait', blocking until they are available), then log it:
+	void retire(uint32_t slot, bool wait);
+};
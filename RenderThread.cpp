@@ -0,0 +1,92 @@
+#include "RenderThread.hpp"
+
+#include "FramePacer.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+RenderThread::RenderThread(SDL_Window *window_, SDL_GLContext context_, FramePacer *pacer_, DrawFunction const &draw_)
+	: window(window_), context(context_), pacer(pacer_), draw(draw_) {
+	//a context can only be current on one thread at a time, so let go of it before the render thread takes it:
+	if (SDL_GL_MakeCurrent(window, NULL) != 0) {
+		throw std::runtime_error(std::string("couldn't release the GL context for the render thread (") + SDL_GetError() + ").");
+	}
+	thread = std::thread(&RenderThread::run, this);
+}
+
+RenderThread::~RenderThread() {
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		quit = true;
+	}
+	published_cv.notify_all();
+	thread.join();
+
+	if (SDL_GL_MakeCurrent(window, context) != 0) {
+		std::cerr << "WARNING: couldn't take back the GL context from the render thread (" << SDL_GetError() << ")." << std::endl;
+	}
+	std::cout << "Render thread drew " << frames << " frames of " << snapshots << " snapshots." << std::endl;
+}
+
+void RenderThread::publish(Game::RenderSnapshot const &snapshot, glm::uvec2 drawable_size, float alpha, float seconds_per_tick) {
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		if (error) std::rethrow_exception(error);
+	}
+
+	//only this thread changes 'front', and the render thread only reads slots[front], so the back slot can be written unlocked:
+	Published &back = slots[1 - front];
+	back.snapshot = snapshot;
+	back.drawable_size = drawable_size;
+	back.time = Clock::now();
+	back.alpha = alpha;
+	back.seconds_per_tick = seconds_per_tick;
+
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		front = 1 - front;
+		published = true;
+		++snapshots;
+	}
+	published_cv.notify_one();
+}
+
+void RenderThread::run() {
+	try {
+		if (SDL_GL_MakeCurrent(window, context) != 0) {
+			throw std::runtime_error(std::string("couldn't make the GL context current on the render thread (") + SDL_GetError() + ").");
+		}
+
+		Published latest;
+		while (true) {
+			pacer->wait();
+
+			{ //take the latest snapshot (the same one again if no ticks have run since the last frame):
+				std::unique_lock< std::mutex > lock(mutex);
+				published_cv.wait(lock, [this](){ return quit || published; });
+				if (quit) break;
+				latest = slots[front];
+			}
+
+			//the avatar keeps moving toward the next tick while it is being simulated:
+			float alpha = latest.alpha;
+			if (latest.seconds_per_tick > 0.0f) {
+				alpha += std::chrono::duration< float >(Clock::now() - latest.time).count() / latest.seconds_per_tick;
+			}
+			alpha = std::min(alpha, 1.0f);
+
+			draw(latest.snapshot, latest.drawable_size, alpha);
+			SDL_GL_SwapWindow(window);
+			pacer->presented();
+			++frames;
+		}
+	} catch (...) {
+		//(publish rethrows this on the simulation thread)
+		std::lock_guard< std::mutex > lock(mutex);
+		error = std::current_exception();
+	}
+
+	SDL_GL_MakeCurrent(window, NULL);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Game.hpp" //for Game::RenderSnapshot
+
+#include <SDL.h>
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+struct FramePacer; //FramePacer.hpp
+
+//RenderThread runs drawing on its own thread (main's --render-thread), so a slow swap or driver stall delays only
+// the frames, never the simulation's ticks: the simulation thread publish()es a Game::RenderSnapshot after its ticks,
+// and the render thread draws and swaps the latest one, as often as 'pacer' lets it, while the next ticks run.
+// Snapshots are double buffered: publish() writes the back slot and swaps it to the front, and the render thread copies
+// the front slot out under the same lock, so neither thread ever waits for more than a snapshot's copy.
+// Between snapshots, frames keep interpolating (the avatar is drawn 'alpha' of the way into the next tick, by the clock).
+// The render thread owns the GL context (the caller's, made current there until the RenderThread is destroyed).
+struct RenderThread {
+	typedef std::chrono::high_resolution_clock Clock;
+
+	//clears the window and calls the game's draw (on the render thread):
+	typedef std::function< void(Game::RenderSnapshot const &snapshot, glm::uvec2 drawable_size, float alpha) > DrawFunction;
+
+	//takes over 'context' (so it must be current on the calling thread, and is released from it):
+	RenderThread(SDL_Window *window, SDL_GLContext context, FramePacer *pacer, DrawFunction const &draw);
+	//stops drawing, then makes 'context' current on the calling thread again:
+	~RenderThread();
+
+	RenderThread(RenderThread const &) = delete;
+	RenderThread &operator=(RenderThread const &) = delete;
+
+	//hand over the state after the latest tick, 'alpha' of the way to the next one, which is due in 'seconds_per_tick' real seconds each:
+	// (rethrows anything that went wrong on the render thread, e.g. while loading)
+	void publish(Game::RenderSnapshot const &snapshot, glm::uvec2 drawable_size, float alpha, float seconds_per_tick);
+
+	//------- internals -------
+
+	struct Published {
+		Game::RenderSnapshot snapshot;
+		glm::uvec2 drawable_size = glm::uvec2(0);
+		Clock::time_point time;
+		float alpha = 1.0f;
+		float seconds_per_tick = 0.0f;
+	};
+
+	SDL_Window *window;
+	SDL_GLContext context;
+	FramePacer *pacer;
+	DrawFunction draw;
+
+	std::mutex mutex; //guards front, published (the flag), quit, and error; plus slots[front]
+	std::condition_variable published_cv;
+	Published slots[2];
+	uint32_t front = 0; //the render thread reads slots[front]; publish writes the other
+	bool published = false; //nothing is drawn before the first publish
+	bool quit = false;
+	std::exception_ptr error;
+
+	uint64_t frames = 0; //drawn
+	uint64_t snapshots = 0; //published
+
+	void run();
+
+	std::thread thread; //last, so everything above exists before the thread starts
+};
@@ -0,0 +1,260 @@
+#include "ShaderCache.hpp"
+
+#include "read_chunk.hpp"
+
+#include <SDL.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+//cache files are a sequence of entries, each a 'prg0' chunk holding one of these, then a 'bin0' chunk of the binary itself:
+struct ShaderCacheEntry {
+	uint64_t key;
+	uint32_t format;
+	uint32_t padding;
+};
+static_assert(sizeof(ShaderCacheEntry) == 16, "ShaderCacheEntry should be packed.");
+
+static std::string read_source(std::string const &path);
+static GLuint compile_shader(GLenum type, std::string const &source);
+
+ShaderCache::ShaderCache(std::string const &cache_path_) : cache_path(cache_path_) {
+	for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+		GLubyte const *str = glGetString(name);
+		driver += (str ? reinterpret_cast< char const * >(str) : "");
+		driver += '\n';
+	}
+
+	//program binaries are past GL 3.3, so their entry points are looked up at runtime:
+	if (SDL_GL_ExtensionSupported("GL_ARB_get_program_binary")) {
+		GetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glGetProgramBinary");
+		ProgramBinary = (PFNGLPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glProgramBinary");
+		ProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)SDL_GL_GetProcAddress("glProgramParameteri");
+	}
+	GLint formats = 0;
+	if (GetProgramBinary && ProgramBinary && ProgramParameteri) {
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	}
+	if (formats == 0) {
+		GetProgramBinary = nullptr;
+		ProgramBinary = nullptr;
+		ProgramParameteri = nullptr;
+		return;
+	}
+
+	std::ifstream file(cache_path, std::ios::binary);
+	if (!file) return; //(no cache yet)
+	try {
+		while (file.peek() != std::char_traits< char >::eof()) {
+			std::vector< ShaderCacheEntry > entry;
+			read_chunk(file, "prg0", &entry);
+			if (entry.size() != 1) throw std::runtime_error("expected one entry header");
+			Binary &binary = binaries[entry[0].key];
+			binary.format = entry[0].format;
+			read_chunk(file, "bin0", &binary.data);
+		}
+	} catch (std::exception &e) {
+		std::cerr << "WARNING: ignoring shader cache '" << cache_path << "' (" << e.what() << ")." << std::endl;
+		binaries.clear();
+	}
+}
+
+ShaderCache::~ShaderCache() {
+	for (auto &program : programs) {
+		glDeleteProgram(program.program);
+		program.program = -1U;
+	}
+}
+
+uint32_t ShaderCache::add(std::string const &prelude, std::string const &vertex_path, std::string const &fragment_path, Attributes const &attributes) {
+	Program program;
+	program.prelude = prelude;
+	program.vertex_path = vertex_path;
+	program.fragment_path = fragment_path;
+	program.attributes = attributes;
+	program.vertex_source = read_source(vertex_path);
+	program.fragment_source = read_source(fragment_path);
+	program.program = build(program);
+	programs.emplace_back(program);
+	return uint32_t(programs.size() - 1);
+}
+
+bool ShaderCache::reload() {
+	bool changed = false;
+	for (auto &program : programs) {
+		Program updated = program;
+		try {
+			updated.vertex_source = read_source(program.vertex_path);
+			updated.fragment_source = read_source(program.fragment_path);
+			if (updated.vertex_source == program.vertex_source && updated.fragment_source == program.fragment_source) continue;
+			updated.program = build(updated);
+		} catch (std::exception &e) {
+			std::cerr << "WARNING: keeping the old '" << program.vertex_path << "' + '" << program.fragment_path << "' program (" << e.what() << ")." << std::endl;
+			continue;
+		}
+		//(the old sources' binary can't be hit again, unless another program still has the same sources)
+		uint64_t old_key = key(program);
+		bool shared = false;
+		for (auto const &other : programs) {
+			if (&other != &program && key(other) == old_key) shared = true;
+		}
+		if (!shared && binaries.erase(old_key)) binaries_changed = true;
+
+		glDeleteProgram(program.program);
+		program = updated;
+		changed = true;
+		std::cout << "Reloaded '" << program.vertex_path << "' + '" << program.fragment_path << "'." << std::endl;
+	}
+	save();
+	return changed;
+}
+
+void ShaderCache::save() {
+	if (binaries_changed) save_cache();
+}
+
+uint64_t ShaderCache::key(Program const &program) const {
+	//FNV-1a over everything that goes into the binary:
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	auto mix = [&hash](std::string const &str) {
+		for (char c : str) {
+			hash = (hash ^ uint8_t(c)) * 0x100000001b3ULL;
+		}
+		hash = (hash ^ 0xff) * 0x100000001b3ULL; //(separator, so "ab" + "c" != "a" + "bc")
+	};
+	mix(driver);
+	mix(program.prelude);
+	mix(program.vertex_source);
+	mix(program.fragment_source);
+	for (auto const &attribute : program.attributes) {
+		mix(attribute.first);
+		mix(std::to_string(attribute.second));
+	}
+	return hash;
+}
+
+GLuint ShaderCache::build(Program const &program) {
+	uint64_t program_key = key(program);
+
+	//try the cached binary first (the driver may still reject it, e.g. after an update it didn't change its version string for):
+	if (ProgramBinary) {
+		auto found = binaries.find(program_key);
+		if (found != binaries.end()) {
+			GLuint loaded = glCreateProgram();
+			ProgramBinary(loaded, found->second.format, found->second.data.data(), GLsizei(found->second.data.size()));
+			GLint link_status = GL_FALSE;
+			glGetProgramiv(loaded, GL_LINK_STATUS, &link_status);
+			if (link_status == GL_TRUE) {
+				++cache_hits;
+				return loaded;
+			}
+			glDeleteProgram(loaded);
+			binaries.erase(found);
+			binaries_changed = true;
+		}
+	}
+	++cache_misses;
+
+	GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, program.prelude + program.vertex_source);
+	GLuint fragment_shader = 0;
+	try {
+		fragment_shader = compile_shader(GL_FRAGMENT_SHADER, program.prelude + program.fragment_source);
+	} catch (...) {
+		glDeleteShader(vertex_shader);
+		throw;
+	}
+
+	GLuint linked = glCreateProgram();
+	glAttachShader(linked, vertex_shader);
+	glAttachShader(linked, fragment_shader);
+	for (auto const &attribute : program.attributes) {
+		glBindAttribLocation(linked, attribute.second, attribute.first.c_str());
+	}
+	if (ProgramParameteri) ProgramParameteri(linked, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(linked);
+
+	//shaders are reference counted so this makes sure they are freed after programs are deleted:
+	glDeleteShader(vertex_shader);
+	glDeleteShader(fragment_shader);
+
+	GLint link_status = GL_FALSE;
+	glGetProgramiv(linked, GL_LINK_STATUS, &link_status);
+	if (link_status != GL_TRUE) {
+		std::cerr << "Failed to link shader program." << std::endl;
+		GLint info_log_length = 0;
+		glGetProgramiv(linked, GL_INFO_LOG_LENGTH, &info_log_length);
+		std::vector< GLchar > info_log(info_log_length + 1, 0);
+		GLsizei length = 0;
+		glGetProgramInfoLog(linked, GLsizei(info_log.size()), &length, &info_log[0]);
+		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
+		glDeleteProgram(linked);
+		throw std::runtime_error("failed to link program");
+	}
+
+	if (GetProgramBinary) {
+		GLint binary_length = 0;
+		glGetProgramiv(linked, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+		if (binary_length > 0) {
+			Binary &binary = binaries[program_key];
+			binary.data.resize(binary_length);
+			GLsizei length = 0;
+			GetProgramBinary(linked, binary_length, &length, &binary.format, binary.data.data());
+			binary.data.resize(length);
+			binaries_changed = true;
+		}
+	}
+
+	return linked;
+}
+
+void ShaderCache::save_cache() {
+	std::ofstream file(cache_path, std::ios::binary);
+	for (auto const &entry : binaries) {
+		ShaderCacheEntry header;
+		header.key = entry.first;
+		header.format = entry.second.format;
+		header.padding = 0;
+		write_chunk(file, "prg0", std::vector< ShaderCacheEntry >(1, header));
+		write_chunk(file, "bin0", entry.second.data);
+	}
+	if (!file) {
+		std::cerr << "WARNING: failed to write shader cache '" << cache_path << "'." << std::endl;
+		return;
+	}
+	binaries_changed = false;
+}
+
+static std::string read_source(std::string const &path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("failed to open shader '" + path + "'.");
+	}
+	std::ostringstream source;
+	source << file.rdbuf();
+	return source.str();
+}
+
+//create and return an OpenGL shader from source; throws if compilation fails:
+static GLuint compile_shader(GLenum type, std::string const &source) {
+	GLuint shader = glCreateShader(type);
+	GLchar const *str = source.c_str();
+	GLint length = GLint(source.size());
+	glShaderSource(shader, 1, &str, &length);
+	glCompileShader(shader);
+	GLint compile_status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
+	if (compile_status != GL_TRUE) {
+		std::cerr << "Failed to compile shader." << std::endl;
+		GLint info_log_length = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_length);
+		std::vector< GLchar > info_log(info_log_length + 1, 0);
+		GLsizei length = 0;
+		glGetShaderInfoLog(shader, GLsizei(info_log.size()), &length, &info_log[0]);
+		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
+		glDeleteShader(shader);
+		throw std::runtime_error("Failed to compile shader.");
+	}
+	return shader;
+}
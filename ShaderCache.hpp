@@ -0,0 +1,76 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+//ShaderCache builds programs from shader files, keeping their linked binaries (glGetProgramBinary) in a cache file,
+// keyed by a hash of the sources and the driver's vendor/renderer/version strings, so later launches skip compiling.
+// reload() re-reads the files and rebuilds any program whose source changed, so shaders can be edited while running.
+// (program binaries need GL 4.1 or ARB_get_program_binary; without them, programs are just compiled every time)
+struct ShaderCache {
+	//cache file to read now and update as programs are built (e.g. data_path("shaders.cache")):
+	explicit ShaderCache(std::string const &cache_path);
+	~ShaderCache(); //deletes the programs it built
+
+	ShaderCache(ShaderCache const &) = delete;
+	ShaderCache &operator=(ShaderCache const &) = delete;
+
+	//attribute names and the locations they are bound to, so rebuilt programs keep working with existing vertex arrays:
+	typedef std::vector< std::pair< std::string, GLuint > > Attributes;
+
+	//build (or load from the cache) a program from 'prelude' (e.g. #version and shared declarations), then each file's source;
+	// returns an index for program(). Throws if the program doesn't compile or link.
+	// (newly built binaries aren't written to the cache file until save())
+	uint32_t add(std::string const &prelude, std::string const &vertex_path, std::string const &fragment_path, Attributes const &attributes);
+
+	//write the cache file, if any binaries were added (or turned out stale) since it was last written; call after a batch of add()s:
+	void save();
+
+	//current program object built for the index returned by add():
+	GLuint program(uint32_t index) const { return programs[index].program; }
+
+	//re-read all programs' files, rebuilding (and re-caching) those that changed, and dropping their old binaries from the cache;
+	// saves the cache once at the end, and returns true if any program object changed.
+	// A program that fails to build is reported and keeps its old program object.
+	// (rebuilt programs have new uniform locations and block bindings, so callers should set those up again)
+	bool reload();
+
+	//------- internals -------
+
+	struct Program {
+		std::string prelude;
+		std::string vertex_path, fragment_path;
+		Attributes attributes;
+		std::string vertex_source, fragment_source; //as last built
+		GLuint program = -1U;
+	};
+	std::vector< Program > programs;
+
+	struct Binary {
+		GLenum format = 0;
+		std::vector< uint8_t > data;
+	};
+	std::map< uint64_t, Binary > binaries; //by key()
+	bool binaries_changed = false; //since the cache file was read or last written
+
+	std::string cache_path;
+	std::string driver; //vendor, renderer, and version strings
+
+	//program binary entry points (null if unsupported):
+	PFNGLGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+	PFNGLPROGRAMBINARYPROC ProgramBinary = nullptr;
+	PFNGLPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+
+	uint32_t cache_hits = 0;
+	uint32_t cache_misses = 0;
+
+	uint64_t key(Program const &program) const;
+	//link (or load the cached binary of) 'program''s current sources; throws on failure:
+	GLuint build(Program const &program);
+	void save_cache();
+};
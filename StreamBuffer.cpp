@@ -0,0 +1,111 @@
+#include "StreamBuffer.hpp"
+
+#include <SDL.h>
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+StreamBuffer::StreamBuffer(GLenum target_, GLsizeiptr frame_size, GLsizeiptr alignment_) : target(target_), alignment(alignment_ > 0 ? alignment_ : 1) {
+	region_size = ((frame_size + alignment - 1) / alignment) * alignment;
+	GLsizeiptr total = region_size * Frames;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(target, buffer);
+
+	//buffer storage is past GL 3.3, so its entry point is looked up at runtime:
+	PFNGLBUFFERSTORAGEPROC BufferStorage = nullptr;
+	if (SDL_GL_ExtensionSupported("GL_ARB_buffer_storage")) {
+		BufferStorage = (PFNGLBUFFERSTORAGEPROC)SDL_GL_GetProcAddress("glBufferStorage");
+	}
+	if (BufferStorage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		BufferStorage(target, total, NULL, flags);
+		mapped = (uint8_t *)glMapBufferRange(target, 0, total, flags);
+		if (mapped) {
+			persistent = true;
+		} else {
+			//(storage is immutable, so start over with a fresh buffer)
+			std::cerr << "WARNING: couldn't persistently map a stream buffer; mapping each write instead." << std::endl;
+			glBindBuffer(target, 0);
+			glDeleteBuffers(1, &buffer);
+			glGenBuffers(1, &buffer);
+			glBindBuffer(target, buffer);
+		}
+	}
+	if (!persistent) {
+		glBufferData(target, total, NULL, GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(target, 0);
+}
+
+StreamBuffer::~StreamBuffer() {
+	if (stalls) {
+		std::cerr << "NOTE: waited on the GPU for stream buffer space " << stalls << " times." << std::endl;
+	}
+
+	for (uint32_t i = 0; i < Frames; ++i) {
+		if (fences[i]) glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+
+	if (persistent) {
+		glBindBuffer(target, buffer);
+		glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+		mapped = nullptr;
+	}
+
+	glDeleteBuffers(1, &buffer);
+	buffer = -1U;
+}
+
+void StreamBuffer::begin_frame() {
+	region = (region + 1) % Frames;
+	used = 0;
+
+	GLsync &fence = fences[region];
+	if (!fence) return;
+	//usually the GPU finished with this region a frame or two ago:
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED) {
+		++stalls;
+		status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000)); //1s, in ns
+	}
+	if (status == GL_WAIT_FAILED || status == GL_TIMEOUT_EXPIRED) {
+		std::cerr << "WARNING: stream buffer fence wait failed; the GPU may still be reading this frame's data." << std::endl;
+	}
+	glDeleteSync(fence);
+	fence = 0;
+}
+
+GLintptr StreamBuffer::write(void const *data, GLsizeiptr size) {
+	GLsizeiptr start = ((used + alignment - 1) / alignment) * alignment;
+	if (start + size > region_size) {
+		throw std::runtime_error("StreamBuffer::write ran past the end of the frame's region.");
+	}
+	used = start + size;
+	GLintptr offset = GLintptr(region) * region_size + start;
+
+	if (persistent) {
+		std::memcpy(mapped + offset, data, size);
+	} else {
+		glBindBuffer(target, buffer);
+		//the region's fence already guarantees the GPU is done with this range:
+		void *to = glMapBufferRange(target, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (!to) {
+			glBindBuffer(target, 0);
+			throw std::runtime_error("failed to map stream buffer range.");
+		}
+		std::memcpy(to, data, size);
+		glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+	}
+	return offset;
+}
+
+void StreamBuffer::end_frame() {
+	if (fences[region]) glDeleteSync(fences[region]);
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <cstdint>
+
+//StreamBuffer hands out space for data that is written once per frame (uniform blocks, per-frame instances, ...),
+// from a buffer split into Frames regions that are used round-robin, one per frame.
+// Each region is fenced when its frame ends, so by the time it comes around again the GPU is (almost always) done with it,
+// and writes never have to orphan storage or wait for the driver to synchronize:
+//  - with ARB_buffer_storage the buffer stays mapped (persistent + coherent) and writes are plain copies;
+//  - otherwise each write maps just its own range, unsynchronized (the fence is what makes that safe).
+struct StreamBuffer {
+	static constexpr uint32_t Frames = 3;
+
+	//'frame_size' bytes of data per frame, with every write starting on a multiple of 'alignment':
+	StreamBuffer(GLenum target, GLsizeiptr frame_size, GLsizeiptr alignment);
+	~StreamBuffer();
+
+	StreamBuffer(StreamBuffer const &) = delete;
+	StreamBuffer &operator=(StreamBuffer const &) = delete;
+
+	//start writing into the next region (waits only if the GPU is still reading it, Frames frames later):
+	void begin_frame();
+
+	//copy 'size' bytes into this frame's region, returning their offset in 'buffer' (for glBindBufferRange, attribute pointers, ...):
+	// (throws if the frame's writes don't fit in frame_size)
+	GLintptr write(void const *data, GLsizeiptr size);
+
+	//fence the region written since begin_frame (call after the frame's last draw that reads it):
+	void end_frame();
+
+	GLenum target;
+	GLuint buffer = -1U;
+	GLsizeiptr alignment = 1;
+	GLsizeiptr region_size = 0; //frame_size rounded up to alignment
+
+	bool persistent = false; //mapped once with ARB_buffer_storage?
+	uint8_t *mapped = nullptr; //(persistent only) the whole buffer
+
+	uint32_t region = 0; //region being written
+	GLsizeiptr used = 0; //bytes of it written so far
+	GLsync fences[Frames] = {};
+
+	uint64_t stalls = 0; //times begin_frame had to wait for the GPU
+};
@@ -0,0 +1,115 @@
+#include "TextureAtlas.hpp"
+
+#include "gl_errors.hpp"
+
+#include <SDL.h>
+#include <png.h>
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+//from EXT_texture_compression_s3tc (which glcorearb.h leaves out, since it never became core):
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+
+TextureAtlas::Image::Image(std::string const &png_path, uint32_t max_levels) {
+	png_image png;
+	std::memset(&png, 0, sizeof(png));
+	png.version = PNG_IMAGE_VERSION;
+	if (!png_image_begin_read_from_file(&png, png_path.c_str())) {
+		throw std::runtime_error("failed to read '" + png_path + "' (" + png.message + ").");
+	}
+	png.format = PNG_FORMAT_RGBA;
+
+	sizes.emplace_back(png.width, png.height);
+	levels.emplace_back(png.width * png.height);
+	//(a negative row stride stores the bottom row first)
+	if (!png_image_finish_read(&png, NULL, levels[0].data(), -png_int_32(PNG_IMAGE_ROW_STRIDE(png)), NULL)) {
+		png_image_free(&png);
+		throw std::runtime_error("failed to decode '" + png_path + "' (" + png.message + ").");
+	}
+
+	//box-filter down to each smaller level:
+	while (levels.size() < max_levels && sizes.back().x % 2 == 0 && sizes.back().y % 2 == 0) {
+		glm::uvec2 from_size = sizes.back();
+		glm::uvec2 size = from_size / 2u;
+		std::vector< glm::u8vec4 > const &from = levels.back();
+		std::vector< glm::u8vec4 > level(size.x * size.y);
+		for (uint32_t y = 0; y < size.y; ++y) {
+			for (uint32_t x = 0; x < size.x; ++x) {
+				glm::u8vec4 const *a = &from[(2 * y) * from_size.x + 2 * x];
+				glm::u8vec4 const *b = a + from_size.x;
+				glm::uvec4 sum = glm::uvec4(a[0]) + glm::uvec4(a[1]) + glm::uvec4(b[0]) + glm::uvec4(b[1]);
+				level[y * size.x + x] = glm::u8vec4((sum + glm::uvec4(2)) / 4u);
+			}
+		}
+		sizes.emplace_back(size);
+		levels.emplace_back(std::move(level));
+	}
+}
+
+TextureAtlas::TextureAtlas(Image const &image) {
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	//the driver compresses each level as it is uploaded, into an explicit block format (so memory and bandwidth are known):
+	// BPTC (BC7, 1 byte per texel) where available, else S3TC DXT5 (BC3, also 1 byte per texel), else plain RGBA8 (4 bytes per texel).
+	// (a generic format like GL_COMPRESSED_RGBA would let the driver pick anything, including not compressing at all)
+	std::vector< GLenum > formats;
+	if (SDL_GL_ExtensionSupported("GL_ARB_texture_compression_bptc")) formats.emplace_back(GL_COMPRESSED_RGBA_BPTC_UNORM);
+	if (SDL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc")) formats.emplace_back(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+	formats.emplace_back(GL_RGBA8);
+
+	glHint(GL_TEXTURE_COMPRESSION_HINT, GL_NICEST);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (GLenum format : formats) {
+		while (glGetError() != GL_NO_ERROR) { } //(so only this format's errors are seen below)
+		for (uint32_t l = 0; l < image.levels.size(); ++l) {
+			glTexImage2D(GL_TEXTURE_2D, l, format, image.sizes[l].x, image.sizes[l].y, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.levels[l].data());
+		}
+		//a driver that can't compress into the format on upload may refuse it, or quietly store something else:
+		GLint stored = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &stored);
+		if (glGetError() == GL_NO_ERROR && GLenum(stored) == format) {
+			internal_format = format;
+			break;
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (internal_format == 0) {
+		throw std::runtime_error("failed to upload the texture atlas.");
+	}
+
+	//only the levels that were built (pack-atlas.py's gutters keep tiles from bleeding together up to there):
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(image.levels.size()) - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	GLint compressed = GL_FALSE;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+	for (uint32_t l = 0; l < image.levels.size(); ++l) {
+		GLint level_bytes = GLint(image.sizes[l].x * image.sizes[l].y * 4);
+		if (compressed) glGetTexLevelParameteriv(GL_TEXTURE_2D, l, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &level_bytes);
+		bytes += level_bytes;
+	}
+	if (!compressed) {
+		std::cerr << "WARNING: neither BPTC nor S3TC compression is available, so the texture atlas is stored as RGBA8 (" << bytes << " bytes)." << std::endl;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GL_ERRORS();
+}
+
+TextureAtlas::~TextureAtlas() {
+	glDeleteTextures(1, &texture);
+	texture = -1U;
+}
+
+void TextureAtlas::bind(GLuint unit) const {
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, texture);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//TextureAtlas is one mipmapped texture holding every mesh texture (packed by meshes/pack-atlas.py),
+// so drawing textured meshes costs a single texture bind per frame.
+// Images are decoded and mipmapped by TextureAtlas::Image (on any thread), then uploaded by the constructor
+// (on the GL thread), compressed by the driver to BPTC or else S3TC DXT5, so the atlas takes a quarter of its RGBA8 size in video memory.
+// Without either extension it falls back to (and warns about) uncompressed RGBA8.
+struct TextureAtlas {
+	//RGBA8 pixels with rows bottom-to-top (as OpenGL expects), and successively halved mip levels:
+	struct Image {
+		//load 'png_path' and build up to 'max_levels' levels (fewer if the image can't be halved evenly); throws on failure:
+		Image(std::string const &png_path, uint32_t max_levels);
+
+		std::vector< glm::uvec2 > sizes;
+		std::vector< std::vector< glm::u8vec4 > > levels;
+	};
+
+	explicit TextureAtlas(Image const &image);
+	~TextureAtlas();
+
+	TextureAtlas(TextureAtlas const &) = delete;
+	TextureAtlas &operator=(TextureAtlas const &) = delete;
+
+	//bind the atlas to texture unit 'unit':
+	void bind(GLuint unit) const;
+
+	GLuint texture = -1U;
+	GLenum internal_format = 0; //GL_COMPRESSED_RGBA_BPTC_UNORM, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, or GL_RGBA8
+	GLint bytes = 0; //video memory used by all levels (as reported for compressed formats; estimated otherwise)
+};
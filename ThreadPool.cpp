@@ -0,0 +1,115 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t count) {
+	if (count == 0) {
+		count = std::max(1U, std::thread::hardware_concurrency());
+	}
+	for (uint32_t i = 0; i < count; ++i) {
+		queues.emplace_back(new Queue);
+	}
+	//thread 0 is whoever calls parallel_for:
+	for (uint32_t i = 1; i < count; ++i) {
+		threads.emplace_back(&ThreadPool::worker, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+void ThreadPool::parallel_for(uint32_t count, uint32_t grain, std::function< void(uint32_t, uint32_t) > const &body) {
+	if (count == 0) return;
+	grain = std::max(1U, grain);
+
+	uint32_t chunks = (count + grain - 1) / grain;
+
+	//not worth waking anyone for a single chunk:
+	if (chunks == 1 || queues.size() == 1) {
+		body(0, count);
+		return;
+	}
+
+	Job job;
+	job.body = &body;
+	job.remaining = chunks;
+
+	//deal chunks out round-robin, so each thread starts with a contiguous-ish share:
+	for (uint32_t c = 0; c < chunks; ++c) {
+		Queue &queue = *queues[c % queues.size()];
+		std::lock_guard< std::mutex > lock(queue.mutex);
+		queue.chunks.emplace_back(Chunk{ &job, c * grain, std::min(count, (c + 1) * grain) });
+	}
+
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		++generation;
+	}
+	wake.notify_all();
+
+	//help out until there is nothing left to take:
+	Chunk chunk;
+	while (take(0, &chunk)) {
+		run(chunk);
+	}
+
+	//...then wait for chunks other threads are still running:
+	std::unique_lock< std::mutex > lock(mutex);
+	done.wait(lock, [&](){ return job.remaining.load() == 0; });
+}
+
+bool ThreadPool::take(uint32_t index, Chunk *chunk) {
+	{ //own queue, newest first:
+		Queue &queue = *queues[index];
+		std::lock_guard< std::mutex > lock(queue.mutex);
+		if (!queue.chunks.empty()) {
+			*chunk = queue.chunks.back();
+			queue.chunks.pop_back();
+			return true;
+		}
+	}
+	//steal from the other queues, oldest first:
+	for (uint32_t offset = 1; offset < queues.size(); ++offset) {
+		Queue &queue = *queues[(index + offset) % queues.size()];
+		std::lock_guard< std::mutex > lock(queue.mutex);
+		if (!queue.chunks.empty()) {
+			*chunk = queue.chunks.front();
+			queue.chunks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::run(Chunk const &chunk) {
+	(*chunk.job->body)(chunk.begin, chunk.end);
+	if (chunk.job->remaining.fetch_sub(1) == 1) {
+		//last chunk of the job; the lock orders this with the waiter's check:
+		std::lock_guard< std::mutex > lock(mutex);
+		done.notify_all();
+	}
+}
+
+void ThreadPool::worker(uint32_t index) {
+	uint64_t seen = 0;
+	while (true) {
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			wake.wait(lock, [&](){ return quit || generation != seen; });
+			if (quit) return;
+			seen = generation;
+		}
+		Chunk chunk;
+		while (take(index, &chunk)) {
+			run(chunk);
+		}
+	}
+}
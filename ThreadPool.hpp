@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The 'ThreadPool' struct runs data-parallel loops on a fixed set of worker threads.
+// parallel_for splits its range into chunks dealt round-robin to per-thread queues;
+// each thread takes chunks from the back of its own queue and, once that is empty,
+// steals from the front of the others', so uneven chunks still balance out.
+// The calling thread works too, and parallel_for returns once every chunk has run.
+// (parallel_for should only be called from one thread at a time.)
+
+struct ThreadPool {
+	//threads == 0 means one per hardware thread:
+	explicit ThreadPool(uint32_t threads = 0);
+	~ThreadPool();
+
+	ThreadPool(ThreadPool const &) = delete;
+	ThreadPool &operator=(ThreadPool const &) = delete;
+
+	//number of threads that run chunks, including the caller of parallel_for:
+	uint32_t size() const { return uint32_t(queues.size()); }
+
+	//calls body(begin, end) over [0, count) in chunks of at most 'grain' items:
+	void parallel_for(uint32_t count, uint32_t grain, std::function< void(uint32_t, uint32_t) > const &body);
+
+private:
+	//shared by all chunks from one parallel_for call:
+	struct Job {
+		std::function< void(uint32_t, uint32_t) > const *body;
+		std::atomic< uint32_t > remaining; //chunks not yet finished
+	};
+	struct Chunk {
+		Job *job;
+		uint32_t begin;
+		uint32_t end;
+	};
+	struct Queue {
+		std::mutex mutex;
+		std::deque< Chunk > chunks;
+	};
+
+	//take a chunk for thread 'index' (its own newest first, then the oldest of another thread's):
+	bool take(uint32_t index, Chunk *chunk);
+	void run(Chunk const &chunk);
+	void worker(uint32_t index);
+
+	std::vector< std::unique_ptr< Queue > > queues; //queues[0] belongs to the caller of parallel_for
+	std::vector< std::thread > threads;
+
+	std::mutex mutex; //guards generation and quit; paired with both condition variables
+	std::condition_variable wake; //new chunks were queued (or quit was set)
+	std::condition_variable done; //some job finished its last chunk
+	uint64_t generation = 0;
+	bool quit = false;
+};
@@ -0,0 +1,292 @@
+#include "batch_kernels.hpp"
+
+#include "game_rules.hpp"
+
+//Which vector kernels get built depends on the target:
+// - x86-64: SSE2 always; AVX2 too, picked at runtime where the compiler can target it per-function
+//   (GCC/clang), or when the whole build already targets it (e.g. MSVC /arch:AVX2).
+// - ARM with NEON: NEON.
+//All of them mirror game_rules.hpp operation-for-operation (no fused multiply-adds, the same
+// comparison and min/max operand order) so that results match the scalar code bit-for-bit:
+//   std::max(a, b) == (a < b ? b : a) == _mm_max_ps(b, a)
+//   std::min(a, b) == (b < a ? b : a) == _mm_min_ps(b, a)
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+	#define SSE2_KERNELS
+	#include <emmintrin.h>
+	#if defined(__GNUC__)
+		#define AVX2_KERNELS
+		#define AVX2_RUNTIME_CHECK
+		#define AVX2_TARGET __attribute__((target("avx2")))
+		#include <immintrin.h>
+	#elif defined(__AVX2__)
+		#define AVX2_KERNELS
+		#define AVX2_TARGET
+		#include <immintrin.h>
+	#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#define NEON_KERNELS
+	#include <arm_neon.h>
+#endif
+
+//------------ scalar ------------
+
+static void scalar_step_avatar_axes(float *position, float *velocity, float const *push, uint32_t count, float elapsed, uint32_t extent) {
+	for (uint32_t i = 0; i < count; ++i) {
+		step_avatar_axis(&position[i], &velocity[i], push[i], elapsed, extent);
+	}
+}
+
+static void scalar_adjacent(float const *ax, float const *ay, float const *bx, float const *by, uint32_t count, float leeway, uint8_t *hit) {
+	for (uint32_t i = 0; i < count; ++i) {
+		hit[i] = adjacent_xy(ax[i], ay[i], bx[i], by[i], leeway);
+	}
+}
+
+BatchKernels const &scalar_batch_kernels() {
+	static BatchKernels const kernels{ "scalar", scalar_step_avatar_axes, scalar_adjacent };
+	return kernels;
+}
+
+//------------ SSE2 (4 boards at a time) ------------
+
+#ifdef SSE2_KERNELS
+
+static inline __m128 sse2_select(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static void sse2_step_avatar_axes(float *position, float *velocity, float const *push, uint32_t count, float elapsed, uint32_t extent) {
+	__m128 const zero = _mm_setzero_ps();
+	__m128 const accelerate = _mm_set1_ps(elapsed * AvatarAcceleration);
+	__m128 const decelerate = _mm_set1_ps(AvatarDeceleration * elapsed);
+	__m128 const max_velocity = _mm_set1_ps(AvatarMaxVelocity);
+	__m128 const min_velocity = _mm_set1_ps(-AvatarMaxVelocity);
+	__m128 const dt = _mm_set1_ps(elapsed);
+	__m128 const lo = _mm_set1_ps(1.0f);
+	__m128 const hi = _mm_set1_ps(float(extent) - 2.0f);
+
+	uint32_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 v = _mm_loadu_ps(velocity + i);
+		__m128 u = _mm_loadu_ps(push + i);
+
+		//pushed, or else slowing toward zero from whichever side:
+		__m128 pushed = _mm_add_ps(v, _mm_mul_ps(u, accelerate));
+		__m128 slowed_positive = _mm_max_ps(_mm_sub_ps(v, decelerate), zero);
+		__m128 slowed_negative = _mm_min_ps(_mm_add_ps(v, decelerate), zero);
+		__m128 r = v;
+		r = sse2_select(_mm_cmplt_ps(v, zero), slowed_negative, r);
+		r = sse2_select(_mm_cmpgt_ps(v, zero), slowed_positive, r);
+		r = sse2_select(_mm_cmpneq_ps(u, zero), pushed, r);
+		v = _mm_min_ps(max_velocity, _mm_max_ps(min_velocity, r));
+
+		__m128 p = _mm_add_ps(_mm_loadu_ps(position + i), _mm_mul_ps(v, dt));
+		p = _mm_min_ps(hi, _mm_max_ps(lo, p));
+		__m128 wall = _mm_or_ps(_mm_cmpeq_ps(p, lo), _mm_cmpeq_ps(p, hi));
+		v = _mm_andnot_ps(wall, v);
+
+		_mm_storeu_ps(position + i, p);
+		_mm_storeu_ps(velocity + i, v);
+	}
+	scalar_step_avatar_axes(position + i, velocity + i, push + i, count - i, elapsed, extent);
+}
+
+static void sse2_adjacent(float const *ax, float const *ay, float const *bx, float const *by, uint32_t count, float leeway, uint8_t *hit) {
+	__m128 const one = _mm_set1_ps(1.0f);
+	__m128 const two = _mm_set1_ps(2.0f);
+	__m128 const slack = _mm_set1_ps(leeway);
+
+	uint32_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 a_x = _mm_loadu_ps(ax + i);
+		__m128 a_y = _mm_loadu_ps(ay + i);
+		__m128 b_x = _mm_loadu_ps(bx + i);
+		__m128 b_y = _mm_loadu_ps(by + i);
+		__m128 x_lo = _mm_sub_ps(_mm_sub_ps(a_x, one), slack);
+		__m128 x_hi = _mm_add_ps(_mm_add_ps(a_x, two), slack);
+		__m128 y_lo = _mm_sub_ps(_mm_sub_ps(a_y, one), slack);
+		__m128 y_hi = _mm_add_ps(_mm_add_ps(a_y, two), slack);
+		__m128 in = _mm_and_ps(
+			_mm_and_ps(_mm_cmpge_ps(b_x, x_lo), _mm_cmple_ps(_mm_add_ps(b_x, one), x_hi)),
+			_mm_and_ps(_mm_cmpge_ps(b_y, y_lo), _mm_cmple_ps(_mm_add_ps(b_y, one), y_hi))
+		);
+		int bits = _mm_movemask_ps(in);
+		for (uint32_t l = 0; l < 4; ++l) {
+			hit[i + l] = (bits >> l) & 1;
+		}
+	}
+	scalar_adjacent(ax + i, ay + i, bx + i, by + i, count - i, leeway, hit + i);
+}
+
+#endif //SSE2_KERNELS
+
+//------------ AVX2 (8 boards at a time) ------------
+
+#ifdef AVX2_KERNELS
+
+AVX2_TARGET static void avx2_step_avatar_axes(float *position, float *velocity, float const *push, uint32_t count, float elapsed, uint32_t extent) {
+	__m256 const zero = _mm256_setzero_ps();
+	__m256 const accelerate = _mm256_set1_ps(elapsed * AvatarAcceleration);
+	__m256 const decelerate = _mm256_set1_ps(AvatarDeceleration * elapsed);
+	__m256 const max_velocity = _mm256_set1_ps(AvatarMaxVelocity);
+	__m256 const min_velocity = _mm256_set1_ps(-AvatarMaxVelocity);
+	__m256 const dt = _mm256_set1_ps(elapsed);
+	__m256 const lo = _mm256_set1_ps(1.0f);
+	__m256 const hi = _mm256_set1_ps(float(extent) - 2.0f);
+
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 v = _mm256_loadu_ps(velocity + i);
+		__m256 u = _mm256_loadu_ps(push + i);
+
+		//pushed, or else slowing toward zero from whichever side:
+		__m256 pushed = _mm256_add_ps(v, _mm256_mul_ps(u, accelerate));
+		__m256 slowed_positive = _mm256_max_ps(_mm256_sub_ps(v, decelerate), zero);
+		__m256 slowed_negative = _mm256_min_ps(_mm256_add_ps(v, decelerate), zero);
+		__m256 r = v;
+		r = _mm256_blendv_ps(r, slowed_negative, _mm256_cmp_ps(v, zero, _CMP_LT_OQ));
+		r = _mm256_blendv_ps(r, slowed_positive, _mm256_cmp_ps(v, zero, _CMP_GT_OQ));
+		r = _mm256_blendv_ps(r, pushed, _mm256_cmp_ps(u, zero, _CMP_NEQ_UQ));
+		v = _mm256_min_ps(max_velocity, _mm256_max_ps(min_velocity, r));
+
+		__m256 p = _mm256_add_ps(_mm256_loadu_ps(position + i), _mm256_mul_ps(v, dt));
+		p = _mm256_min_ps(hi, _mm256_max_ps(lo, p));
+		__m256 wall = _mm256_or_ps(_mm256_cmp_ps(p, lo, _CMP_EQ_OQ), _mm256_cmp_ps(p, hi, _CMP_EQ_OQ));
+		v = _mm256_andnot_ps(wall, v);
+
+		_mm256_storeu_ps(position + i, p);
+		_mm256_storeu_ps(velocity + i, v);
+	}
+	scalar_step_avatar_axes(position + i, velocity + i, push + i, count - i, elapsed, extent);
+}
+
+AVX2_TARGET static void avx2_adjacent(float const *ax, float const *ay, float const *bx, float const *by, uint32_t count, float leeway, uint8_t *hit) {
+	__m256 const one = _mm256_set1_ps(1.0f);
+	__m256 const two = _mm256_set1_ps(2.0f);
+	__m256 const slack = _mm256_set1_ps(leeway);
+
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 a_x = _mm256_loadu_ps(ax + i);
+		__m256 a_y = _mm256_loadu_ps(ay + i);
+		__m256 b_x = _mm256_loadu_ps(bx + i);
+		__m256 b_y = _mm256_loadu_ps(by + i);
+		__m256 x_lo = _mm256_sub_ps(_mm256_sub_ps(a_x, one), slack);
+		__m256 x_hi = _mm256_add_ps(_mm256_add_ps(a_x, two), slack);
+		__m256 y_lo = _mm256_sub_ps(_mm256_sub_ps(a_y, one), slack);
+		__m256 y_hi = _mm256_add_ps(_mm256_add_ps(a_y, two), slack);
+		__m256 in = _mm256_and_ps(
+			_mm256_and_ps(_mm256_cmp_ps(b_x, x_lo, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(b_x, one), x_hi, _CMP_LE_OQ)),
+			_mm256_and_ps(_mm256_cmp_ps(b_y, y_lo, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(b_y, one), y_hi, _CMP_LE_OQ))
+		);
+		int bits = _mm256_movemask_ps(in);
+		for (uint32_t l = 0; l < 8; ++l) {
+			hit[i + l] = (bits >> l) & 1;
+		}
+	}
+	scalar_adjacent(ax + i, ay + i, bx + i, by + i, count - i, leeway, hit + i);
+}
+
+#endif //AVX2_KERNELS
+
+//------------ NEON (4 boards at a time) ------------
+
+#ifdef NEON_KERNELS
+
+//NEON's vmax/vmin differ from std::max/std::min on signed zeros and NaNs, so compare and select instead:
+static inline float32x4_t neon_max(float32x4_t a, float32x4_t b) { //std::max(a, b)
+	return vbslq_f32(vcltq_f32(a, b), b, a);
+}
+static inline float32x4_t neon_min(float32x4_t a, float32x4_t b) { //std::min(a, b)
+	return vbslq_f32(vcltq_f32(b, a), b, a);
+}
+
+static void neon_step_avatar_axes(float *position, float *velocity, float const *push, uint32_t count, float elapsed, uint32_t extent) {
+	float32x4_t const zero = vdupq_n_f32(0.0f);
+	float32x4_t const accelerate = vdupq_n_f32(elapsed * AvatarAcceleration);
+	float32x4_t const decelerate = vdupq_n_f32(AvatarDeceleration * elapsed);
+	float32x4_t const max_velocity = vdupq_n_f32(AvatarMaxVelocity);
+	float32x4_t const min_velocity = vdupq_n_f32(-AvatarMaxVelocity);
+	float32x4_t const dt = vdupq_n_f32(elapsed);
+	float32x4_t const lo = vdupq_n_f32(1.0f);
+	float32x4_t const hi = vdupq_n_f32(float(extent) - 2.0f);
+
+	uint32_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t v = vld1q_f32(velocity + i);
+		float32x4_t u = vld1q_f32(push + i);
+
+		//pushed, or else slowing toward zero from whichever side (separate multiply and add, never fused):
+		float32x4_t pushed = vaddq_f32(v, vmulq_f32(u, accelerate));
+		float32x4_t slowed_positive = neon_max(zero, vsubq_f32(v, decelerate));
+		float32x4_t slowed_negative = neon_min(zero, vaddq_f32(v, decelerate));
+		float32x4_t r = v;
+		r = vbslq_f32(vcltq_f32(v, zero), slowed_negative, r);
+		r = vbslq_f32(vcgtq_f32(v, zero), slowed_positive, r);
+		r = vbslq_f32(vmvnq_u32(vceqq_f32(u, zero)), pushed, r);
+		v = neon_min(neon_max(r, min_velocity), max_velocity);
+
+		float32x4_t p = vaddq_f32(vld1q_f32(position + i), vmulq_f32(v, dt));
+		p = neon_min(neon_max(p, lo), hi);
+		uint32x4_t wall = vorrq_u32(vceqq_f32(p, lo), vceqq_f32(p, hi));
+		v = vbslq_f32(wall, zero, v);
+
+		vst1q_f32(position + i, p);
+		vst1q_f32(velocity + i, v);
+	}
+	scalar_step_avatar_axes(position + i, velocity + i, push + i, count - i, elapsed, extent);
+}
+
+static void neon_adjacent(float const *ax, float const *ay, float const *bx, float const *by, uint32_t count, float leeway, uint8_t *hit) {
+	float32x4_t const one = vdupq_n_f32(1.0f);
+	float32x4_t const two = vdupq_n_f32(2.0f);
+	float32x4_t const slack = vdupq_n_f32(leeway);
+
+	uint32_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t a_x = vld1q_f32(ax + i);
+		float32x4_t a_y = vld1q_f32(ay + i);
+		float32x4_t b_x = vld1q_f32(bx + i);
+		float32x4_t b_y = vld1q_f32(by + i);
+		float32x4_t x_lo = vsubq_f32(vsubq_f32(a_x, one), slack);
+		float32x4_t x_hi = vaddq_f32(vaddq_f32(a_x, two), slack);
+		float32x4_t y_lo = vsubq_f32(vsubq_f32(a_y, one), slack);
+		float32x4_t y_hi = vaddq_f32(vaddq_f32(a_y, two), slack);
+		uint32x4_t in = vandq_u32(
+			vandq_u32(vcgeq_f32(b_x, x_lo), vcleq_f32(vaddq_f32(b_x, one), x_hi)),
+			vandq_u32(vcgeq_f32(b_y, y_lo), vcleq_f32(vaddq_f32(b_y, one), y_hi))
+		);
+		uint32_t lanes[4];
+		vst1q_u32(lanes, in);
+		for (uint32_t l = 0; l < 4; ++l) {
+			hit[i + l] = lanes[l] & 1;
+		}
+	}
+	scalar_adjacent(ax + i, ay + i, bx + i, by + i, count - i, leeway, hit + i);
+}
+
+#endif //NEON_KERNELS
+
+//------------ selection ------------
+
+BatchKernels const &best_batch_kernels() {
+	#ifdef AVX2_KERNELS
+	static BatchKernels const avx2{ "avx2", avx2_step_avatar_axes, avx2_adjacent };
+	#ifdef AVX2_RUNTIME_CHECK
+	if (__builtin_cpu_supports("avx2"))
+	#endif
+	return avx2;
+	#endif
+
+	#ifdef SSE2_KERNELS
+	static BatchKernels const sse2{ "sse2", sse2_step_avatar_axes, sse2_adjacent };
+	return sse2;
+	#endif
+
+	#ifdef NEON_KERNELS
+	static BatchKernels const neon{ "neon", neon_step_avatar_axes, neon_adjacent };
+	return neon;
+	#endif
+
+	return scalar_batch_kernels();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+//batch_kernels.hpp declares the inner loops of BatchSim::step_range, over flat per-board arrays.
+// Each set of kernels computes exactly what step_avatar_axis and adjacent_xy (game_rules.hpp)
+// compute for every element -- bit-for-bit, so any set can be checked against the scalar one.
+
+struct BatchKernels {
+	char const *name;
+
+	//step_avatar_axis(&position[i], &velocity[i], push[i], elapsed, extent) for i in [0, count):
+	void (*step_avatar_axes)(float *position, float *velocity, float const *push, uint32_t count, float elapsed, uint32_t extent);
+
+	//hit[i] = adjacent_xy(ax[i], ay[i], bx[i], by[i], leeway) for i in [0, count):
+	void (*adjacent)(float const *ax, float const *ay, float const *bx, float const *by, uint32_t count, float leeway, uint8_t *hit);
+};
+
+//plain C++ loops over game_rules.hpp's functions (the reference results):
+BatchKernels const &scalar_batch_kernels();
+
+//the widest vector kernels this CPU runs -- AVX2 (8 boards at a time), SSE2 or NEON (4 at a time) --
+// or the scalar kernels if there are none:
+BatchKernels const &best_batch_kernels();
@@ -0,0 +1,232 @@
+//bench steps GameState -- or, with --boards, a BatchSim -- headless (no window, GL, or audio)
+// under a scripted player and reports how fast the update path runs:
+//   bench [--ticks <n>] [--tick-rate <hz>] [--seed <s>] [--board <w>x<h>] [--level-pool] [--record <log>] [--boards <n> [--threads <n>] [--scalar] [--verify]]
+//   bench --replay <log> [--level-pool]
+//(--record saves the scripted player's session as an InputLog; --replay steps a recorded session -- e.g., from main --record -- instead)
+
+#include "GameState.hpp"
+#include "BatchSim.hpp"
+#include "ThreadPool.hpp"
+#include "InputLog.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+//boards per chunk of work when stepping a BatchSim:
+#define BENCH_GRAIN 2048
+
+//scripted player, one axis at a time: push toward the next counter of the sandwich,
+// but let go once within the distance needed to stop from the current velocity:
+static float bot_push(float to_target, float velocity) {
+	float stopping = velocity * velocity / (2.0f * AvatarDeceleration);
+	bool approaching = (to_target > 0.0f) == (velocity > 0.0f);
+	if (std::abs(to_target) <= 0.5f || (approaching && stopping >= std::abs(to_target))) {
+		return 0.0f;
+	}
+	return to_target < 0.0f ? -1.0f : 1.0f;
+}
+
+static void steer(GameState &state) {
+	glm::vec3 target = glm::vec3(state.level_progression[state.next_pickup]->location);
+	float push_x = bot_push(target.x - state.avatar_location.x, state.x_velocity);
+	float push_y = bot_push(target.y - state.avatar_location.y, state.y_velocity);
+	state.controls.go_left = (push_x < 0.0f);
+	state.controls.go_right = (push_x > 0.0f);
+	state.controls.go_down = (push_y < 0.0f);
+	state.controls.go_up = (push_y > 0.0f);
+}
+
+static void steer(BatchSim &sim, uint32_t begin, uint32_t end) {
+	for (uint32_t b = begin; b < end; ++b) {
+		sim.push_x[b] = bot_push(sim.next_x[b] - sim.avatar_x[b], sim.velocity_x[b]);
+		sim.push_y[b] = bot_push(sim.next_y[b] - sim.avatar_y[b], sim.velocity_y[b]);
+	}
+}
+
+int main(int argc, char **argv) {
+	struct {
+		uint64_t ticks = 10000000;
+		float tick_rate = 60.0f;
+		uint64_t seed = 0;
+		//boards > 0 steps a BatchSim of that many boards (for 'ticks' ticks) instead of one GameState:
+		uint32_t boards = 0;
+		uint32_t threads = 0; //0 means one per hardware thread
+		bool scalar = false; //step the BatchSim with scalar_batch_kernels() instead of best_batch_kernels()
+		bool verify = false; //also step a scalar-kernel BatchSim and check every tick matches it bit-for-bit
+		bool level_pool = false; //have the GameState take levels from a LevelPool
+		glm::uvec2 board = glm::uvec2(9, 9);
+		std::string record; //save the session to this InputLog, if set
+		std::string replay; //play back this InputLog instead of scripting the player, if set
+	} config;
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--ticks" && argi + 1 < argc) {
+			config.ticks = std::stoull(argv[++argi]);
+		} else if (arg == "--tick-rate" && argi + 1 < argc) {
+			config.tick_rate = std::stof(argv[++argi]);
+		} else if (arg == "--seed" && argi + 1 < argc) {
+			config.seed = std::stoull(argv[++argi]);
+		} else if (arg == "--boards" && argi + 1 < argc) {
+			config.boards = std::stoul(argv[++argi]);
+		} else if (arg == "--threads" && argi + 1 < argc) {
+			config.threads = std::stoul(argv[++argi]);
+		} else if (arg == "--scalar") {
+			config.scalar = true;
+		} else if (arg == "--verify") {
+			config.verify = true;
+		} else if (arg == "--level-pool") {
+			config.level_pool = true;
+		} else if (arg == "--board" && argi + 1 < argc) {
+			std::string size = argv[++argi];
+			size_t x = size.find('x');
+			if (x == std::string::npos) {
+				std::cerr << "Board size should look like '<width>x<height>'." << std::endl;
+				return 1;
+			}
+			config.board = glm::uvec2(std::stoul(size.substr(0, x)), std::stoul(size.substr(x + 1)));
+		} else if (arg == "--record" && argi + 1 < argc) {
+			config.record = argv[++argi];
+		} else if (arg == "--replay" && argi + 1 < argc) {
+			config.replay = argv[++argi];
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--ticks <n>] [--tick-rate <hz>] [--seed <s>] [--board <w>x<h>] [--level-pool] [--record <log>] [--boards <n> [--threads <n>] [--scalar] [--verify]]\n"
+				"\t" << argv[0] << " --replay <log> [--level-pool]" << std::endl;
+			return 1;
+		}
+	}
+
+	//a replay runs the recorded session, whatever the other options say:
+	InputLog replay;
+	if (!config.replay.empty()) {
+		if (config.boards != 0 || !config.record.empty()) {
+			std::cerr << "--replay steps a single board, and can't be combined with --boards or --record." << std::endl;
+			return 1;
+		}
+		replay.load(config.replay);
+		config.ticks = replay.ticks;
+		config.tick_rate = replay.tick_rate;
+		config.seed = replay.seed;
+		config.board = glm::uvec2(replay.board_width, replay.board_height);
+	}
+	if (!config.record.empty() && config.boards != 0) {
+		std::cerr << "--record only records a single board." << std::endl;
+		return 1;
+	}
+
+	if (!(config.tick_rate > 0.0f)) {
+		std::cerr << "Tick rate must be positive." << std::endl;
+		return 1;
+	}
+	if (config.board.x < MinBoardSize || config.board.y < MinBoardSize) {
+		std::cerr << "Boards must be at least " << MinBoardSize << "x" << MinBoardSize << "." << std::endl;
+		return 1;
+	}
+
+	float const tick = 1.0f / config.tick_rate;
+	double simulated = double(config.ticks) * tick;
+
+	if (config.boards == 0) {
+		GameState state(config.seed);
+		if (config.level_pool) state.use_level_pool();
+		if (config.board != state.board_size) state.set_board_size(config.board);
+
+		uint64_t pickups = 0;
+
+		InputLog record;
+		record.seed = config.seed;
+		record.tick_rate = config.tick_rate;
+		record.board_width = config.board.x;
+		record.board_height = config.board.y;
+
+		std::unique_ptr< InputLog::Player > player;
+		if (!config.replay.empty()) player.reset(new InputLog::Player(replay));
+
+		auto before = std::chrono::high_resolution_clock::now();
+		for (uint64_t t = 0; t < config.ticks; ++t) {
+			if (player) {
+				uint8_t mask = 0;
+				player->next(&mask);
+				InputLog::set_controls(&state, mask);
+			} else {
+				steer(state);
+			}
+			if (!config.record.empty()) record.record(InputLog::controls_mask(state));
+			state.update(tick);
+			if (state.picked_up >= 0) ++pickups;
+		}
+		auto after = std::chrono::high_resolution_clock::now();
+
+		if (!config.record.empty()) {
+			record.final_sandwiches = state.num_sandwiches;
+			record.save(config.record);
+			std::cout << "Recorded " << record.ticks << " ticks (" << record.changes.size() << " bytes of changes) to '" << config.record << "'." << std::endl;
+		}
+
+		double seconds = std::chrono::duration< double >(after - before).count();
+
+		std::cout << config.ticks << " ticks (" << simulated << " simulated seconds) in " << seconds << " seconds." << std::endl;
+		std::cout << "  " << (config.ticks / seconds) << " ticks/sec" << std::endl;
+		std::cout << "  " << (state.num_sandwiches / seconds) << " sandwiches/sec (" << state.num_sandwiches << " sandwiches, " << pickups << " pickups)" << std::endl;
+
+		if (player && state.num_sandwiches != replay.final_sandwiches) {
+			std::cerr << "Replay diverged: made " << state.num_sandwiches << " sandwiches, but the recording made " << replay.final_sandwiches << "." << std::endl;
+			return 1;
+		}
+	} else {
+		ThreadPool pool(config.threads);
+		BatchSim sim(config.boards, config.seed, config.board);
+		if (config.scalar) sim.kernels = &scalar_batch_kernels();
+
+		//steering and stepping share a pass, so each thread's boards stay in its cache:
+		auto tick_sim = [&pool, tick](BatchSim &s) {
+			pool.parallel_for(s.count, BENCH_GRAIN, [&s, tick](uint32_t begin, uint32_t end) {
+				steer(s, begin, end);
+				s.step_range(begin, end, tick);
+			});
+		};
+
+		if (config.verify) {
+			BatchSim reference(config.boards, config.seed, config.board);
+			reference.kernels = &scalar_batch_kernels();
+
+			auto same = [](std::vector< float > const &a, std::vector< float > const &b) {
+				return std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+			};
+
+			for (uint64_t t = 0; t < config.ticks; ++t) {
+				tick_sim(sim);
+				tick_sim(reference);
+				if (!same(sim.avatar_x, reference.avatar_x) || !same(sim.avatar_y, reference.avatar_y)
+				 || !same(sim.velocity_x, reference.velocity_x) || !same(sim.velocity_y, reference.velocity_y)
+				 || sim.picked_up != reference.picked_up || sim.num_sandwiches != reference.num_sandwiches) {
+					std::cerr << "Kernels '" << sim.kernels->name << "' differ from '" << reference.kernels->name << "' after tick " << t << "." << std::endl;
+					return 1;
+				}
+			}
+			std::cout << "Kernels '" << sim.kernels->name << "' match '" << reference.kernels->name << "' bit-for-bit over " << config.ticks << " ticks of " << sim.count << " boards." << std::endl;
+			return 0;
+		}
+
+		auto before = std::chrono::high_resolution_clock::now();
+		for (uint64_t t = 0; t < config.ticks; ++t) {
+			tick_sim(sim);
+		}
+		auto after = std::chrono::high_resolution_clock::now();
+
+		double seconds = std::chrono::duration< double >(after - before).count();
+		double board_ticks = double(config.ticks) * sim.count;
+		uint64_t sandwiches = sim.total_sandwiches();
+
+		std::cout << config.ticks << " ticks of " << sim.count << " boards on " << pool.size() << " threads with '" << sim.kernels->name << "' kernels (" << simulated << " simulated seconds) in " << seconds << " seconds." << std::endl;
+		std::cout << "  " << (config.ticks / seconds) << " ticks/sec" << std::endl;
+		std::cout << "  " << (board_ticks / seconds) << " board-ticks/sec" << std::endl;
+		std::cout << "  " << (sandwiches / seconds) << " sandwiches/sec (" << sandwiches << " sandwiches)" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,31 @@
+#!/bin/sh
+#Build dist/main and dist/bench with profile-guided optimization (see 'variants' in the Jamfile):
+# 1. build instrumented executables (VARIANT=pgo-train);
+# 2. record a profile by running the headless benchmark on the single-board and batched paths;
+# 3. rebuild everything (VARIANT=pgo) optimized with that profile.
+#Arguments are passed along to jam (e.g., ./build-pgo.sh -j4).
+
+set -e
+cd "$(dirname "$0")"
+
+PROFILE=objs/pgo/profile
+
+#start from scratch, so old objects and stale profile data aren't mixed in:
+rm -rf objs/pgo
+jam -sVARIANT=pgo-train "$@" bench
+
+dist/bench --ticks 200000 --seed 1 --level-pool
+dist/bench --ticks 2000 --boards 4096 --seed 1
+
+#clang leaves raw profiles that must be merged first:
+if ls "$PROFILE"/*.profraw >/dev/null 2>&1; then
+	if command -v xcrun >/dev/null 2>&1; then
+		xcrun llvm-profdata merge -output="$PROFILE/default.profdata" "$PROFILE"/*.profraw
+	else
+		llvm-profdata merge -output="$PROFILE/default.profdata" "$PROFILE"/*.profraw
+	fi
+fi
+
+#jam doesn't notice changed flags, so remove the instrumented objects (keeping the profile) before rebuilding:
+rm -f objs/pgo/*.o
+jam -sVARIANT=pgo "$@"
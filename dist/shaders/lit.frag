@@ -0,0 +1,29 @@
+//lit.frag: sun/sky (well, directional+hemispherical) lighting of vertex colors, times the texture atlas if TEXTURED.
+// (built with TEXTURED and the Frame block prepended; see FRAME_BLOCK_GLSL in Game.cpp)
+in vec3 position;
+in vec3 normal;
+in vec4 color;
+#if TEXTURED
+in vec2 texcoord;
+uniform sampler2D atlas;
+#endif
+out vec4 fragColor;
+void main() {
+	vec3 total_light = vec3(0.0, 0.0, 0.0);
+	vec3 n = normalize(normal);
+	{ //sky (hemisphere) light:
+		vec3 l = sky_direction.xyz;
+		float nl = 0.5 + 0.5 * dot(n,l);
+		total_light += nl * sky_color.rgb;
+	}
+	{ //sun (directional) light:
+		vec3 l = sun_direction.xyz;
+		float nl = max(0.0, dot(n,l));
+		total_light += nl * sun_color.rgb;
+	}
+	vec3 albedo = color.rgb;
+	#if TEXTURED
+	albedo *= texture(atlas, texcoord).rgb;
+	#endif
+	fragColor = vec4(albedo * total_light, color.a);
+}
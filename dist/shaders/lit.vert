@@ -0,0 +1,25 @@
+//lit.vert: draws a mesh with the object_to_world uniform transform.
+// (built with the Frame block prepended; see FRAME_BLOCK_GLSL in Game.cpp)
+uniform mat4 object_to_world;
+layout(location=0) in vec4 Position; //note: layout keyword used to make sure that the location-0 attribute is always bound to something
+in vec3 Normal;
+in vec4 Color;
+#if TEXTURED
+in vec2 TexCoord;
+#endif
+out vec3 position;
+out vec3 normal;
+out vec4 color;
+#if TEXTURED
+out vec2 texcoord;
+#endif
+void main() {
+	gl_Position = world_to_clip * object_to_world * model_scale * Position;
+	position = mat4x3(object_to_world) * Position;
+	//NOTE: objects are only rotated and translated, so the upper 3x3 is its own inverse transpose:
+	normal = mat3(object_to_world) * Normal;
+	color = Color;
+	#if TEXTURED
+	texcoord = TexCoord;
+	#endif
+}
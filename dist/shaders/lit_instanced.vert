@@ -0,0 +1,24 @@
+//lit_instanced.vert: draws many copies of a mesh, with the object_to_world transform supplied per-instance.
+// (built with the Frame block prepended; see FRAME_BLOCK_GLSL in Game.cpp)
+layout(location=0) in vec4 Position;
+in vec3 Normal;
+in vec4 Color;
+#if TEXTURED
+in vec2 TexCoord;
+#endif
+in mat4 Object_to_world; //per-instance attribute
+out vec3 position;
+out vec3 normal;
+out vec4 color;
+#if TEXTURED
+out vec2 texcoord;
+#endif
+void main() {
+	gl_Position = world_to_clip * Object_to_world * model_scale * Position;
+	position = mat4x3(Object_to_world) * Position;
+	normal = mat3(Object_to_world) * Normal;
+	color = Color;
+	#if TEXTURED
+	texcoord = TexCoord;
+	#endif
+}
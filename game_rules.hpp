@@ -0,0 +1,160 @@
+#pragma once
+
+//game_rules.hpp holds the per-board rules shared by GameState (one board, drawn by Game)
+// and BatchSim (many boards, stepped headless), so both simulate exactly the same game.
+
+#include "occupancy_grid.hpp"
+#include "pcg32.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+// avatar movement
+// NOTE: Based on discussion from http://www.cplusplus.com/forum/general/29835/
+// (tuned when the avatar moved 'velocity' tiles every update at ~60 updates per second)
+constexpr float AvatarMaxVelocity = 9.0f; // tiles per second
+constexpr float AvatarAcceleration = 45.0f; // tiles per second per second
+constexpr float AvatarDeceleration = 45.0f;
+
+//key counters, in the order they are placed by place_key_counters:
+enum : uint32_t { Peanut = 0, Bread = 1, Jelly = 2, Serve = 3, KeyCounters = 4 };
+
+//order in which key counters must be visited to make a sandwich:
+constexpr uint32_t ProgressionLength = 5;
+constexpr uint8_t Progression[ProgressionLength] = { Bread, Peanut, Jelly, Bread, Serve };
+
+//leeway with which the avatar must be adjacent to the next counter to pick it up:
+constexpr float PickupLeeway = 0.5f;
+
+// Positions on grid where (bx,by) is adjacent to (ax,ay) with leeway of 0.0f:
+//          B B B
+//          B A B
+//          B B B
+inline bool adjacent_xy(float ax, float ay, float bx, float by, float leeway) {
+	float x_lo = ax - 1.0f - leeway;
+	float x_hi = ax + 2.0f + leeway;
+	float y_lo = ay - 1.0f - leeway;
+	float y_hi = ay + 2.0f + leeway;
+
+	return (bx >= x_lo && bx + 1.0f <= x_hi) && (by >= y_lo && by + 1.0f <= y_hi);
+}
+
+//one axis of one avatar tick: accelerate by 'push' (-1, 0, or +1 -- the net of the held controls),
+// or decelerate to a stop when there is no push, unless 'coast' is set (both of the axis's controls held: keep the current velocity);
+// then move, staying within the board's interior [1, extent-2]:
+inline void step_avatar_axis(float *position, float *velocity, float push, float elapsed, uint32_t extent, bool coast = false) {
+	float v = *velocity;
+	if (push != 0.0f) {
+		v += push * (elapsed * AvatarAcceleration);
+	} else if (coast) {
+		//(no acceleration and no deceleration)
+	} else if (v > 0.0f) {
+		v = std::max(0.0f, v - AvatarDeceleration * elapsed);
+	} else if (v < 0.0f) {
+		v = std::min(0.0f, v + AvatarDeceleration * elapsed);
+	}
+	v = std::min(std::max(v, -AvatarMaxVelocity), AvatarMaxVelocity);
+
+	float lo = 1.0f;
+	float hi = float(extent) - 2.0f;
+	float p = std::min(std::max(*position + v * elapsed, lo), hi);
+
+	// Prevent avatar from "sticking" to counters
+	if (p == lo || p == hi) {
+		v = 0.0f;
+	}
+
+	*position = p;
+	*velocity = v;
+}
+
+//the four board edges (level generation puts one key counter on each):
+struct BoardEdge {
+	uint8_t is_row;
+	uint8_t is_end;
+};
+constexpr uint32_t BoardEdges = 4;
+constexpr BoardEdge BoardEdgeList[BoardEdges] = { {1,0} /*top*/, {1,1} /*bottom*/, {0,0} /*left*/, {0,1} /*right*/ };
+
+//smallest board (cells on a side) with room for the avatar and a key counter on each edge, spaced apart:
+constexpr uint32_t MinBoardSize = 5;
+
+//counters must be at least this many cells apart in x or y, which is what adjacent_xy(a, b, 1.0f) == false means for cells:
+constexpr uint32_t CounterSpacing = 2;
+
+//where a level's key counters are (in Peanut, Bread, Jelly, Serve order) and which edge (index into BoardEdgeList) each is on:
+// (the progression through them is always Progression, and rotations follow from the edges)
+struct LevelLayout {
+	glm::uvec3 locations[KeyCounters];
+	uint8_t edges[KeyCounters];
+};
+
+//place each key counter on a different edge, away from each other:
+// 'near_counters' is scratch space, left marking the cells too close to a counter for another.
+inline LevelLayout generate_layout(glm::uvec2 board_size, Pcg32 &random, OccupancyGrid *near_counters) {
+	LevelLayout layout;
+	near_counters->reset(board_size);
+
+	//cell 'placement' (in [1, length-2]) along an edge:
+	auto edge_location = [&](BoardEdge const &edge, uint32_t placement) {
+		if (edge.is_row) {
+			return glm::uvec3(placement, edge.is_end * (board_size.y-1), 0);
+		} else {
+			return glm::uvec3(edge.is_end * (board_size.x-1), placement, 0);
+		}
+	};
+
+	// Randomly place key counters on edges
+	uint8_t remaining_edges[BoardEdges] = { 0, 1, 2, 3 };
+	uint32_t remaining = BoardEdges;
+	for (uint32_t i = 0; i < KeyCounters; ++i) {
+		uint32_t pick = random.bounded(remaining);
+		uint8_t e = remaining_edges[pick];
+		BoardEdge const &edge = BoardEdgeList[e];
+
+		//remove the edge (order doesn't matter; picks are random):
+		remaining_edges[pick] = remaining_edges[--remaining];
+
+		uint32_t length = edge.is_row ? board_size.x : board_size.y;
+		uint32_t placement = 1 + random.bounded(length-2);
+		glm::uvec3 location = edge_location(edge, placement);
+
+		// Make sure counter doesn't spawn near the others (trying each cell along the edge in turn)
+		uint32_t start_placement = placement;
+		while (near_counters->test(location.x, location.y)) {
+			placement = 1 + placement % (length - 2);
+			if (placement == start_placement) {
+				break;
+			}
+			location = edge_location(edge, placement);
+		}
+
+		layout.locations[i] = location;
+		layout.edges[i] = e;
+		near_counters->set_around(location.x, location.y, CounterSpacing);
+	}
+	return layout;
+}
+
+//true if no counter in 'layout' spawns near the avatar:
+inline bool layout_clear_of(LevelLayout const &layout, glm::vec2 avatar_location) {
+	for (uint32_t i = 0; i < KeyCounters; ++i) {
+		glm::uvec3 const &l = layout.locations[i];
+		if (adjacent_xy(float(l.x), float(l.y), avatar_location.x, avatar_location.y, 1.0f)) return false;
+	}
+	return true;
+}
+
+//reset 'counters' to mark the cells holding the layout's key counters:
+inline void mark_layout(LevelLayout const &layout, glm::uvec2 board_size, OccupancyGrid *counters) {
+	counters->reset(board_size);
+	for (uint32_t i = 0; i < KeyCounters; ++i) {
+		counters->set(layout.locations[i].x, layout.locations[i].y);
+	}
+}
+
+//layouts are generated without knowing where the avatar will be, and those that spawn a counter near it are skipped;
+// after this many in a row are skipped (e.g., on a board too small to avoid the avatar), the next is used regardless:
+constexpr uint32_t MaxLayoutRejections = 64;
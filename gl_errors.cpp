@@ -0,0 +1,47 @@
+#include "gl_errors.hpp"
+
+#include <SDL.h>
+
+bool gl_errors_reported_by_callback = false;
+
+#ifndef GL_ERRORS_OFF
+//called by the driver (possibly from its own thread, some time after the offending call):
+static void APIENTRY report_gl_debug_message(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, GLchar const *message, void const *user) {
+	//notifications (e.g., where a buffer was placed) are just noise:
+	if (severity == GL_DEBUG_SEVERITY_NOTIFICATION) return;
+
+	char const *kind = "message";
+	if (type == GL_DEBUG_TYPE_ERROR) kind = "error";
+	else if (type == GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR) kind = "deprecated behavior";
+	else if (type == GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR) kind = "undefined behavior";
+	else if (type == GL_DEBUG_TYPE_PERFORMANCE) kind = "performance";
+
+	std::cerr << "WARNING: gl debug " << kind << " (id " << id << "): "
+		<< (length >= 0 ? std::string(message, length) : std::string(message)) << std::endl;
+}
+#endif
+
+bool gl_errors_use_debug_callback() {
+#ifdef GL_ERRORS_OFF
+	return false;
+#else
+	//only debug contexts are required to report anything:
+	GLint flags = 0;
+	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+	if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT)) return false;
+
+	if (!SDL_GL_ExtensionSupported("GL_KHR_debug")) return false;
+
+	//KHR_debug is past GL 3.3, so its entry point is looked up at runtime:
+	PFNGLDEBUGMESSAGECALLBACKPROC DebugMessageCallback = (PFNGLDEBUGMESSAGECALLBACKPROC)SDL_GL_GetProcAddress("glDebugMessageCallback");
+	if (!DebugMessageCallback) return false;
+
+	DebugMessageCallback(report_gl_debug_message, nullptr);
+	glEnable(GL_DEBUG_OUTPUT);
+	//let the driver report errors whenever it notices them, instead of stalling on every call:
+	glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+
+	gl_errors_reported_by_callback = true;
+	return true;
+#endif
+}
@@ -7,7 +7,19 @@
 #define STR2(X) # X
 #define STR(X) STR2(X)
 
-inline void gl_errors(std::string const &where) {
+//GL errors are checked in one of three ways:
+// - compiled out entirely, when GL_ERRORS_OFF is defined (the release variant in the Jamfile);
+// - reported asynchronously by the driver, once gl_errors_use_debug_callback() succeeds (needs KHR_debug and a debug context);
+// - otherwise, by polling glGetError at each GL_ERRORS() (which can stall until the GPU catches up).
+
+//set once the KHR_debug callback is reporting errors, so GL_ERRORS() no longer polls:
+extern bool gl_errors_reported_by_callback;
+
+//install a KHR_debug message callback (call after creating the context); returns false if it can't be used:
+bool gl_errors_use_debug_callback();
+
+inline void gl_errors(char const *where) {
+	if (gl_errors_reported_by_callback) return;
 	GLenum err = 0;
 	while ((err = glGetError()) != GL_NO_ERROR) {
 		#define CHECK( ERR ) \
@@ -28,5 +40,9 @@ inline void gl_errors(std::string const &where) {
 		#undef CHECK
 	}
 }
+#ifdef GL_ERRORS_OFF
+#define GL_ERRORS() do { } while (0)
+#else
 #define GL_ERRORS() gl_errors(__FILE__  ":" STR(__LINE__) )
+#endif
 
@@ -1,9 +1,27 @@
 //Game.hpp declares the "game" object, which handles game-specific stuff:
 #include "Game.hpp"
 
+//Profiler times main loop phases and draw passes (enabled with --profile):
+#include "Profiler.hpp"
+
+//InputLog records and replays sessions' controls (--record, --replay):
+#include "InputLog.hpp"
+
+//FramePacer sets the swap interval or sleeps to a target rate, and measures frame jitter (--pacing, --target-fps):
+#include "FramePacer.hpp"
+
+//RenderThread draws on its own thread while the simulation ticks on this one (--render-thread):
+#include "RenderThread.hpp"
+
+//Metrics sends frame, update, and gameplay statistics to a statsd server (--metrics):
+#include "Metrics.hpp"
+
 //GL.hpp will include a non-namespace-polluting set of opengl prototypes:
 #include "GL.hpp"
 
+//...and gl_errors.hpp chooses how GL errors get reported:
+#include "gl_errors.hpp"
+
 //Includes for libSDL:
 #include <SDL.h>
 
@@ -19,19 +37,172 @@
 #include <fstream>
 #include <memory>
 #include <algorithm>
+#include <string>
+#include <random>
+#include <thread>
 
 int main(int argc, char **argv) {
 	struct {
 		std::string title = "Undercooked";
 		glm::uvec2 size = glm::uvec2(640, 640);
+		//simulation advances in fixed ticks of 1 / tick_rate seconds unless variable_timestep is set:
+		bool variable_timestep = false;
+		float tick_rate = 60.0f;
+		//simulated seconds per real second (e.g. > 1 to run bots faster than real time):
+		float time_scale = 1.0f;
+		//most ticks run per frame before the simulation gives up on catching up (times time_scale, so faster-than-real-time runs aren't held back):
+		uint32_t max_ticks_per_frame = 8;
+		//level generator seed (random unless given, and printed so a run can be repeated):
+		bool have_seed = false;
+		uint64_t seed = 0;
+		//per-frame timings are logged here (as CSV) and summarized at exit, if set:
+		bool profile = false;
+		std::string profile_csv;
+		//poll glGetError even if the driver could report errors asynchronously:
+		bool sync_gl_errors = false;
+		//save the session's controls to this InputLog, if set:
+		std::string record;
+		//play back this InputLog (at one tick per frame, as fast as frames can be drawn) instead of reading the keyboard, if set:
+		std::string replay;
+		//board size, in cells:
+		glm::uvec2 board = glm::uvec2(9, 9);
+		//the camera tracks the avatar instead of fitting the whole board (on by default for boards too big to see at once):
+		bool follow_camera = false;
+		//cells across the view when following the avatar:
+		float view_cells = 16.0f;
+		//how frames are paced (replays always run uncapped):
+		FramePacer::Mode pacing = FramePacer::Adaptive;
+		float target_fps = 30.0f; //for FramePacer::TargetFps
+		//read the keyboard's state just before each tick, rather than only applying the events polled at the start of the frame:
+		bool late_input = false;
+		//draw and swap on a render thread, so the simulation's ticks never wait on the GPU or the display:
+		bool render_thread = false;
+		//send metrics to this statsd server (<host>:<port>), if set, every metrics_interval seconds:
+		std::string metrics;
+		float metrics_interval = 10.0f;
 	} config;
 
+	//------------ command line ------------
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		//helper to fetch the value following an option:
+		auto value = [&]() -> std::string {
+			if (argi + 1 >= argc) {
+				std::cerr << "Option '" << arg << "' expects a value." << std::endl;
+				exit(1);
+			}
+			return argv[++argi];
+		};
+		if (arg == "--variable-timestep") {
+			config.variable_timestep = true;
+		} else if (arg == "--tick-rate") {
+			config.tick_rate = std::stof(value());
+		} else if (arg == "--time-scale") {
+			config.time_scale = std::stof(value());
+		} else if (arg == "--max-ticks-per-frame") {
+			config.max_ticks_per_frame = std::stoul(value());
+		} else if (arg == "--seed") {
+			config.seed = std::stoull(value());
+			config.have_seed = true;
+		} else if (arg == "--profile") {
+			config.profile = true;
+			config.profile_csv = value();
+		} else if (arg == "--profile-summary") {
+			config.profile = true;
+		} else if (arg == "--sync-gl-errors") {
+			config.sync_gl_errors = true;
+		} else if (arg == "--record") {
+			config.record = value();
+		} else if (arg == "--replay") {
+			config.replay = value();
+		} else if (arg == "--board") {
+			std::string size = value();
+			size_t x = size.find('x');
+			if (x == std::string::npos) {
+				std::cerr << "Board size should look like '<width>x<height>'." << std::endl;
+				return 1;
+			}
+			config.board = glm::uvec2(std::stoul(size.substr(0, x)), std::stoul(size.substr(x + 1)));
+		} else if (arg == "--follow-camera") {
+			config.follow_camera = true;
+		} else if (arg == "--view-cells") {
+			config.view_cells = std::stof(value());
+			config.follow_camera = true;
+		} else if (arg == "--pacing") {
+			std::string mode = value();
+			if (!FramePacer::parse_mode(mode, &config.pacing)) {
+				std::cerr << "Unknown pacing mode '" << mode << "' (expected uncapped, vsync, adaptive, or fps)." << std::endl;
+				return 1;
+			}
+		} else if (arg == "--late-input") {
+			config.late_input = true;
+		} else if (arg == "--render-thread") {
+			config.render_thread = true;
+		} else if (arg == "--metrics") {
+			config.metrics = value();
+		} else if (arg == "--metrics-interval") {
+			config.metrics_interval = std::stof(value());
+		} else if (arg == "--target-fps") {
+			config.target_fps = std::stof(value());
+			config.pacing = FramePacer::TargetFps;
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--tick-rate <hz>] [--time-scale <s>] [--max-ticks-per-frame <n>] [--variable-timestep] [--seed <n>] [--profile <frames.csv> | --profile-summary] [--sync-gl-errors] [--record <log> | --replay <log>] [--board <w>x<h>] [--follow-camera] [--view-cells <n>] [--pacing uncapped|vsync|adaptive|fps] [--target-fps <hz>] [--late-input] [--render-thread] [--metrics <host>:<port> [--metrics-interval <s>]]" << std::endl;
+			return 1;
+		}
+	}
+
+	if (!(config.tick_rate > 0.0f) || !(config.time_scale > 0.0f) || config.max_ticks_per_frame == 0 || !(config.target_fps > 0.0f) || !(config.metrics_interval > 0.0f) || !(config.view_cells > 0.0f)) {
+		std::cerr << "Tick rate, time scale, max ticks per frame, target fps, metrics interval, and view cells must be positive." << std::endl;
+		return 1;
+	}
+
+	//a replay repeats the recorded session's levels and ticks:
+	InputLog replay_log;
+	if (!config.replay.empty()) {
+		if (!config.record.empty()) {
+			std::cerr << "Can't both --record and --replay." << std::endl;
+			return 1;
+		}
+		replay_log.load(config.replay);
+		config.seed = replay_log.seed;
+		config.have_seed = true;
+		config.tick_rate = replay_log.tick_rate;
+		config.variable_timestep = false;
+		config.board = glm::uvec2(replay_log.board_width, replay_log.board_height);
+		config.pacing = FramePacer::Uncapped;
+		std::cout << "Replaying " << replay_log.ticks << " ticks from '" << config.replay << "'." << std::endl;
+	}
+	if (config.board.x < MinBoardSize || config.board.y < MinBoardSize) {
+		std::cerr << "Boards must be at least " << MinBoardSize << "x" << MinBoardSize << "." << std::endl;
+		return 1;
+	}
+	//(past 32 cells across, counters get too small to make out when the whole board is in view)
+	if (config.board.x > 32 || config.board.y > 32) {
+		config.follow_camera = true;
+	}
+	if (!config.record.empty() && config.variable_timestep) {
+		std::cerr << "Sessions can only be recorded with a fixed timestep." << std::endl;
+		return 1;
+	}
+	//(replays tick once per drawn frame, and the profiler times both threads' work as one frame, so neither fits the pipeline)
+	if (config.render_thread && (config.variable_timestep || !config.replay.empty() || config.profile)) {
+		std::cerr << "The render thread only runs with a fixed timestep, and without --replay or --profile." << std::endl;
+		return 1;
+	}
+
+	if (!config.have_seed) {
+		std::random_device device;
+		config.seed = (uint64_t(device()) << 32) | device();
+	}
+	std::cout << "Level seed: " << config.seed << " (repeat these levels with --seed " << config.seed << ")" << std::endl;
+
 	//------------  initialization ------------
 
 	//Initialize SDL library:
 	SDL_Init(SDL_INIT_VIDEO);
 
-	//Ask for an OpenGL context version 3.3, core profile, enable debug:
+	//Ask for an OpenGL context version 3.3, core profile, enable debug (unless GL error checks are compiled out):
 	SDL_GL_ResetAttributes();
 	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
 	SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
@@ -41,7 +212,9 @@ int main(int argc, char **argv) {
 	SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
 	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	#ifndef GL_ERRORS_OFF
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+	#endif
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
 
@@ -75,13 +248,20 @@ int main(int argc, char **argv) {
 	init_gl_shims();
 	#endif
 
-	//Set VSYNC + Late Swap (prevents crazy FPS):
-	if (SDL_GL_SetSwapInterval(-1) != 0) {
-		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
-		if (SDL_GL_SetSwapInterval(1) != 0) {
-			std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << ")." << std::endl;
-		}
+	#ifndef GL_ERRORS_OFF
+	//have the driver report GL errors as they happen, so GL_ERRORS() doesn't stall every frame:
+	if (!config.sync_gl_errors && !gl_errors_use_debug_callback()) {
+		std::cerr << "NOTE: KHR_debug unavailable; checking GL errors with glGetError." << std::endl;
+	}
+	#endif
+
+	//Set VSYNC + Late Swap (prevents crazy FPS) by default, or whatever pacing was asked for:
+	float refresh_rate = 0.0f;
+	{
+		SDL_DisplayMode display_mode;
+		if (SDL_GetWindowDisplayMode(window, &display_mode) == 0) refresh_rate = float(display_mode.refresh_rate);
 	}
+	FramePacer pacer(config.pacing, config.target_fps, refresh_rate);
 
 	//Hide mouse cursor (note: showing can be useful for debugging):
 	//SDL_ShowCursor(SDL_DISABLE);
@@ -90,7 +270,22 @@ int main(int argc, char **argv) {
 	//------------ create game object (loads assets) --------------
 
 	// shared_ptr ref deleted when last shared_ptr to ref is destroyed (e.g. exceptions)
-	std::shared_ptr< Game > game = std::make_shared< Game >();
+	std::shared_ptr< Game > game = std::make_shared< Game >(config.seed);
+	if (config.board != game->state.board_size) game->state.set_board_size(config.board);
+	game->follow_camera = config.follow_camera;
+	game->view_cells = config.view_cells;
+
+	std::unique_ptr< Profiler > profiler;
+	if (config.profile) {
+		profiler.reset(new Profiler(config.profile_csv));
+		game->profiler = profiler.get();
+	}
+
+	std::unique_ptr< Metrics > metrics;
+	if (!config.metrics.empty()) {
+		metrics.reset(new Metrics(config.metrics, "undercooked", config.metrics_interval));
+		game->metrics = metrics.get();
+	}
 
 	//------------ main loop ------------
 
@@ -106,26 +301,82 @@ int main(int argc, char **argv) {
 		window_size = glm::uvec2(w, h);
 		SDL_GL_GetDrawableSize(window, &w, &h);
 		drawable_size = glm::uvec2(w, h);
-		glViewport(0, 0, drawable_size.x, drawable_size.y);	// Specify viewport size for Gl
 	};
 	on_resize();
 
+	//clear the window and draw the game, on whichever thread owns the GL context:
+	// (metrics' frame times are measured from one draw to the next, since with the render thread those are the frames)
+	std::chrono::high_resolution_clock::time_point last_draw;
+	auto draw_frame = [&](Game::RenderSnapshot const &snapshot, glm::uvec2 size, float alpha) {
+		glViewport(0, 0, size.x, size.y);	// Specify viewport size for Gl
+		//clear the depth+color buffers and set some default state:
+		glClearColor(0.5, 0.5, 0.5, 0.0);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		game->draw(size, snapshot, alpha);
+
+		if (metrics) {
+			auto now = std::chrono::high_resolution_clock::now();
+			if (last_draw != std::chrono::high_resolution_clock::time_point()) {
+				metrics->frame_ms.add(std::chrono::duration< float, std::milli >(now - last_draw).count());
+			}
+			last_draw = now;
+			metrics->draw_calls.add(float(game->draw_calls));
+		}
+	};
+
+	//with --render-thread, the GL context (and the pacer) belong to the render thread from here on:
+	// (it must be stopped before 'game' goes away)
+	std::unique_ptr< RenderThread > render_thread;
+	if (config.render_thread) {
+		render_thread.reset(new RenderThread(window, context, &pacer, draw_frame));
+	}
+
+	//recording, or replay, of the controls held each tick (only ticks after loading count, since others don't change the state):
+	InputLog record_log;
+	record_log.seed = config.seed;
+	record_log.tick_rate = config.tick_rate;
+	record_log.board_width = config.board.x;
+	record_log.board_height = config.board.y;
+	std::unique_ptr< InputLog::Player > player;
+	if (!config.replay.empty()) player.reset(new InputLog::Player(replay_log));
+	std::chrono::high_resolution_clock::time_point replay_start;
+	int exit_code = 0;
+
+	//save the recording (call once the session is over, before the game goes away):
+	auto finish_recording = [&]() {
+		if (config.record.empty() || !game) return;
+		record_log.final_sandwiches = game->state.num_sandwiches;
+		record_log.save(config.record);
+		std::cout << "Recorded " << record_log.ticks << " ticks (" << record_log.changes.size() << " bytes of changes) to '" << config.record << "'." << std::endl;
+	};
+
 	//This will loop until the game object is set to null:
 	while (game) {
+		//(with a target fps, wait for this frame's start time -- before reading input, so it's as fresh as it can be)
+		if (!render_thread) pacer.wait();
+
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
+		if (profiler) profiler->begin_frame();
 
 		{ //(1) process any events that are pending
+			Profiler::Scope scope(profiler.get(), Profiler::Events);
 			static SDL_Event evt;
 			while (SDL_PollEvent(&evt) == 1) {
 				//handle resizing:
 				if (evt.type == SDL_WINDOWEVENT && evt.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
 					on_resize();
 				}
-				//handle input:
-				if (game && game->handle_event(evt, window_size)) {
+				//handle input (replays ignore the keyboard):
+				if (game && !player && game->handle_event(evt, window_size)) {
 					// mode handled it; great
 				} else if (evt.type == SDL_QUIT) {
+					finish_recording();
+					render_thread.reset();
 					game.reset(); //done: deallocate game
 					break;
 				}
@@ -133,35 +384,112 @@ int main(int argc, char **argv) {
 			if (!game) break;
 		}
 
+		//how far the frame falls between the last two ticks (for interpolated drawing):
+		float alpha = 1.0f;
+
 		{ //(2) call the game's "update" function to deal with elapsed time:
+			Profiler::Scope scope(profiler.get(), Profiler::Update);
 			auto current_time = std::chrono::high_resolution_clock::now();
 			static auto previous_time = current_time;
 			float elapsed = std::chrono::duration< float >(current_time - previous_time).count();
 			previous_time = current_time;
 
-			//if frames are taking a very long time to process,
-			//lag to avoid spiral of death:
-			elapsed = std::min(0.1f, elapsed);
+			elapsed *= config.time_scale;
+
+			if (player) {
+				//replays ignore the clock, running one recorded tick per frame:
+				float const tick = 1.0f / config.tick_rate;
+				uint8_t mask = 0;
+				if (!game->loaded) {
+					//(timing starts with the first frame that can tick)
+					replay_start = current_time;
+				} else if (player->next(&mask)) {
+					InputLog::set_controls(&game->state, mask);
+					game->update(tick);
+				} else {
+					double seconds = std::chrono::duration< double >(current_time - replay_start).count();
+					std::cout << "Replayed " << player->tick << " ticks in " << seconds << " seconds (" << (player->tick / seconds) << " frames/sec)." << std::endl;
+					if (game->state.num_sandwiches != replay_log.final_sandwiches) {
+						std::cerr << "WARNING: replay diverged: made " << game->state.num_sandwiches << " sandwiches, but the recording made " << replay_log.final_sandwiches << "." << std::endl;
+						exit_code = 1;
+					}
+					game.reset();
+				}
+			} else if (config.variable_timestep) {
+				//if frames are taking a very long time to process,
+				//lag to avoid spiral of death:
+				elapsed = std::min(0.1f * config.time_scale, elapsed);
+
+				if (config.late_input) game->sample_controls();
+				game->update(elapsed);
+			} else {
+				//run however many whole ticks have accumulated; the remainder carries over to the next frame:
+				float const tick = 1.0f / config.tick_rate;
+				static float accumulator = 0.0f;
+				accumulator += elapsed;
+
+				//if frames are taking a very long time to process,
+				//drop the backlog to avoid spiral of death:
+				// (the cap is in simulated time, so it scales with time_scale like the 0.1s lag for variable timesteps)
+				accumulator = std::min(accumulator, tick * config.max_ticks_per_frame * config.time_scale);
+
+				while (accumulator >= tick) {
+					if (config.late_input) game->sample_controls();
+					if (!config.record.empty() && game->loaded) record_log.record(InputLog::controls_mask(game->state));
+					game->update(tick);
+					accumulator -= tick;
+				}
 
-			game->update(elapsed);
+				alpha = accumulator / tick;
+			}
+			if (metrics) {
+				metrics->update_ms.add(std::chrono::duration< float, std::milli >(std::chrono::high_resolution_clock::now() - current_time).count());
+			}
 			if (!game) break;
 		}
 
+		if (render_thread) {
+			//the render thread draws and swaps by itself; this thread just hands over the ticks' result,
+			// then sleeps until the next tick is due:
+			Game::RenderSnapshot snapshot;
+			game->snapshot(&snapshot);
+			float const seconds_per_tick = 1.0f / (config.tick_rate * config.time_scale);
+			render_thread->publish(snapshot, drawable_size, alpha, seconds_per_tick);
+			std::this_thread::sleep_for(std::chrono::duration< float >((1.0f - alpha) * seconds_per_tick));
+			continue;
+		}
+
 		{ //(3) call the game's "draw" function to produce output:
-			//clear the depth+color buffers and set some default state:
-			glClearColor(0.5, 0.5, 0.5, 0.0);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glEnable(GL_DEPTH_TEST);
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-			game->draw(drawable_size);
+			Profiler::Scope scope(profiler.get(), Profiler::Draw);
+			Game::RenderSnapshot snapshot;
+			game->snapshot(&snapshot);
+			draw_frame(snapshot, drawable_size, alpha);
 		}
 
-		//Finally, wait until the recently-drawn frame is shown before doing it all again:
-		SDL_GL_SwapWindow(window);
+		{ //Finally, wait until the recently-drawn frame is shown before doing it all again:
+			Profiler::Scope scope(profiler.get(), Profiler::Swap);
+			SDL_GL_SwapWindow(window);
+		}
+		pacer.presented();
+
+		//this frame is the first to show any input simulated since the last one:
+		// (measured to when the swap returns, which is when the frame is displayed with vsync, or queued without)
+		if (game->input_simulated) {
+			float ms = std::chrono::duration< float, std::milli >(Game::Clock::now() - game->input_time).count();
+			if (profiler) profiler->input_latency(ms);
+			game->input_pending = false;
+			game->input_simulated = false;
+		}
 	}
 
+	//(already stopped if the game quit)
+	render_thread.reset();
+
+	pacer.report();
+
+	//GPU timings are read back (and summarized) while the context still exists:
+	profiler.reset();
+
 
 	//------------  teardown ------------
 
@@ -171,5 +499,5 @@ int main(int argc, char **argv) {
 	SDL_DestroyWindow(window);
 	window = NULL;
 
-	return 0;
+	return exit_code;
 }
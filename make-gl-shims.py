@@ -20,7 +20,7 @@ with open('glcorearb.h', 'r') as f:
 				protos.append("\n// " + in_version + " prototypes:\n")
 				do_proto = True
 				do_extension = False
-			elif (major,minor) < (3,3):
+			elif (major,minor) <= (3,3):
 				extensions.append("\n// " + in_version + " extensions:\n")
 				do_proto = False
 				do_extension = True
@@ -35,7 +35,7 @@ with open('glcorearb.h', 'r') as f:
 				pass
 			if do_extension:
 			#	m = re.match(r".* PFNGL([^)]+)PROC\)", line)
-				m = re.match(r"GLAPI .* APIENTRY gl([^ ]+) \(", line)
+				m = re.match(r"GLAPI .*APIENTRY gl(\w+) \(", line)
 				if m != None:
 					lc = m.group(1)
 					uc = lc.upper()
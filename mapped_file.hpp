@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <type_traits>
+
+//MappedFile maps an entire file read-only into the address space.
+// Data stays valid until the MappedFile is destroyed; pages are loaded by the OS on first touch
+// and are shared between processes mapping the same file.
+//   MappedFile blob(data_path("meshes.blob"));
+struct MappedFile {
+	MappedFile(std::string const &filename); //throws on failure
+	~MappedFile();
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+
+	char const *data = nullptr;
+	size_t size = 0;
+
+private:
+	#if defined(_WIN32)
+	void *file = nullptr; //HANDLE
+	void *mapping = nullptr; //HANDLE
+	#endif
+};
+
+//ChunkView is a range of structures stored directly in a MappedFile:
+template< typename T >
+struct ChunkView {
+	T const *data = nullptr;
+	size_t size = 0;
+
+	T const *begin() const { return data; }
+	T const *end() const { return data + size; }
+	T const &operator[](size_t i) const { return data[i]; }
+};
+
+//check (without consuming it) whether the chunk at offset has the given magic number:
+inline bool next_chunk_is(MappedFile const &from, size_t offset, std::string const &magic) {
+	assert(magic.size() == 4);
+	return offset <= from.size && from.size - offset >= 8 && std::memcmp(from.data + offset, magic.data(), 4) == 0;
+}
+
+//map_chunk is the zero-copy counterpart of read_chunk:
+// it checks the chunk header at *offset, points 'to' at the chunk's data inside the mapping,
+// and advances *offset past the chunk.
+template< typename T >
+void map_chunk(MappedFile const &from, size_t *_offset, std::string const &magic, ChunkView< T > *_to) {
+	static_assert(std::is_trivially_copyable< T >::value, "chunk elements are used in-place, so must be plain data");
+	assert(_offset);
+	assert(_to);
+	auto &offset = *_offset;
+	auto &to = *_to;
+
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t size = 0;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+
+	ChunkHeader header;
+	if (offset > from.size || from.size - offset < sizeof(header)) {
+		throw std::runtime_error("Failed to read chunk header");
+	}
+	std::memcpy(&header, from.data + offset, sizeof(header));
+	offset += sizeof(header);
+
+	if (std::string(header.magic,4) != magic) {
+		throw std::runtime_error("Unexpected magic number in chunk");
+	}
+
+	if (header.size % sizeof(T) != 0) {
+		throw std::runtime_error("Size of chunk not divisible by element size");
+	}
+
+	if (from.size - offset < header.size) {
+		throw std::runtime_error("Failed to read chunk data.");
+	}
+
+	if (reinterpret_cast< uintptr_t >(from.data + offset) % alignof(T) != 0) {
+		throw std::runtime_error("Chunk data is not aligned for its element type (pad the preceding chunk).");
+	}
+
+	to.data = reinterpret_cast< T const * >(from.data + offset);
+	to.size = header.size / sizeof(T);
+	offset += header.size;
+}
@@ -3,74 +3,134 @@
 #based on 'export-sprites.py' and 'glsprite.py' from TCHOW Rainbow; code used is released into the public domain.
 
 #Note: Script meant to be executed from within blender, as per:
-#blender --background --python export-meshes.py -- <infile.blend> <outfile.blob>
+#blender --background --python export-meshes.py -- [--atlas <layout.txt>] <infile.blend> <outfile.blob>
+#or, to re-encode a blob written in the old unindexed 'dat0' format (no blender needed):
+#python3 export-meshes.py --from-dat0 <infile.blob> <outfile.blob>
 
 import sys
 
-args = []
+#(blender passes the script's own arguments after a '--')
+args = sys.argv[1:]
 for i in range(0,len(sys.argv)):
 	if sys.argv[i] == '--':
 		args = sys.argv[i+1:]
 
-if len(args) != 2:
-	print("\n\nUsage:\nblender --background --python export-meshes.py -- <infile.blend> <outfile.blob>\nExports the meshes referenced by all objects to a binary blob, indexed by the names of the objects that reference them.\n")
+from_dat0 = False
+if len(args) >= 1 and args[0] == '--from-dat0':
+	from_dat0 = True
+	args = args[1:]
+
+#texture rectangles in the atlas made by pack-atlas.py, by texture name (the image file name, less its extension):
+atlas = None
+if len(args) >= 2 and args[0] == '--atlas':
+	atlas = {}
+	for line in open(args[1], 'r'):
+		fields = line.split()
+		if len(fields) == 5:
+			atlas[fields[0]] = tuple(float(f) for f in fields[1:])
+	args = args[2:]
+
+if len(args) != 2 or (from_dat0 and atlas != None):
+	print("\n\nUsage:\nblender --background --python export-meshes.py -- [--atlas <layout.txt>] <infile.blend> <outfile.blob>\nExports the meshes referenced by all objects to a binary blob, indexed by the names of the objects that reference them.\nWith --atlas, texture coordinates are remapped into the atlas laid out by pack-atlas.py and exported too.\n\npython3 export-meshes.py --from-dat0 <infile.blob> <outfile.blob>\nRe-encodes a blob of unindexed 'dat0' vertices in the format below (without texture coordinates, which 'dat0' blobs never had).\n")
 	exit(1)
 
 infile = args[0]
 outfile = args[1]
 
-import bpy, mathutils
 import struct
+import os
 
-import argparse
+do_texcoord = (atlas != None)
+do_vertcolor = True
 
-bpy.ops.wm.open_mainfile(filepath=infile)
+#Output format (each chunk is a 4-byte magic, a uint32 length, then data):
+# 'dat1' -- deduplicated vertices, 16 bytes each:
+#           half-float position (x,y,z,1), normal packed as signed 2_10_10_10 (x in the low bits), rgba8 color
+#  or (with --atlas)
+# 'dat2' -- the same, plus atlas texture coordinates as unsigned normalized 16-bit (u,v), for 20 bytes each
+# 'str0' -- mesh names (padded to a multiple of four bytes)
+# 'ind1' -- uint16 triangle indices, relative to the first vertex of their mesh (padded to a multiple of four bytes)
+# 'idx1' -- per mesh: name_begin, name_end, vertex_begin, vertex_end, index_begin, index_end (uint32s)
 
-do_texcoord = False
-do_vertcolor = True
+#IEEE 754 binary16 bits for a float, rounding to nearest even
+# (struct's 'e' format would do this, but needs a newer python than blender 2.79 ships):
+def half_bits(f):
+	bits = struct.unpack('<I', struct.pack('<f', f))[0]
+	sign = (bits >> 16) & 0x8000
+	exp = ((bits >> 23) & 0xff) - 127 + 15
+	mant = bits & 0x7fffff
+	if exp >= 31: #too large (or inf/nan): clamp to infinity
+		return sign | 0x7c00
+	if exp <= 0: #subnormal (or zero) in half precision
+		if exp < -10:
+			return sign
+		mant |= 0x800000
+		shift = 14 - exp
+		half = mant >> shift
+		rem = mant & ((1 << shift) - 1)
+		halfway = 1 << (shift - 1)
+		if rem > halfway or (rem == halfway and (half & 1)):
+			half += 1
+		return sign | half
+	half = (exp << 10) | (mant >> 13)
+	rem = mant & 0x1fff
+	if rem > 0x1000 or (rem == 0x1000 and (half & 1)):
+		half += 1 #carry into the exponent is correct here
+	return sign | half
 
-#names of objects whose meshes to write (not actually the names of the meshes):
-to_write = []
-for obj in bpy.data.objects:
-	if obj.type == 'MESH':
-		to_write.append(obj.name)
+#normal packed for GL_INT_2_10_10_10_REV (signed, normalized):
+def pack_normal(n):
+	packed = 0
+	for i in range(0,3):
+		c = int(round(max(-1.0, min(1.0, n[i])) * 511.0))
+		packed |= (c & 0x3ff) << (10 * i)
+	return packed
 
-#data contains vertex and normal data from the meshes:
+#data contains (deduplicated) vertex data from the meshes:
 data = b''
 
 #strings contains the mesh names:
 strings = b''
 
-#index gives offsets into the data (and names) for each mesh:
+#indices contains triangles, as offsets from the first vertex of their mesh:
+indices = b''
+
+#index gives offsets into the data, indices (and names) for each mesh:
 index = b''
 
 vertex_count = 0
-for name in to_write:
-	print("Writing '" + name + "'...")
-	bpy.ops.object.mode_set(mode='OBJECT') #get out of edit mode (just in case)
-	assert(name in bpy.data.objects)
-	obj = bpy.data.objects[name]
-
-	obj.data = obj.data.copy() #make mesh single user, just in case it is shared with another object the script needs to write later.
-
-	#make sure object is on a visible layer:
-	bpy.context.scene.layers = obj.layers
-	#select the object and make it the active object:
-	bpy.ops.object.select_all(action='DESELECT')
-	obj.select = True
-	bpy.context.scene.objects.active = obj
-
-	#subdivide object's mesh into triangles:
-	bpy.ops.object.mode_set(mode='EDIT')
-	bpy.ops.mesh.select_all(action='SELECT')
-	bpy.ops.mesh.quads_convert_to_tris(quad_method='BEAUTY', ngon_method='BEAUTY')
-	bpy.ops.object.mode_set(mode='OBJECT')
-
-	#compute normals (respecting face smoothing):
-	mesh = obj.data
-	mesh.calc_normals_split()
-
-	#record mesh name, start position and vertex count in the index:
+index_count = 0
+
+#unsigned normalized 16-bit value:
+def unorm16(f):
+	return int(round(max(0.0, min(1.0, f)) * 65535.0))
+
+#the bytes of one vertex; 'color' is rgb in [0,1], 'uv' is already in the atlas (and only written with --atlas):
+def pack_vertex(co, normal, color, uv):
+	vertex = struct.pack('HHHH', half_bits(co[0]), half_bits(co[1]), half_bits(co[2]), half_bits(1.0))
+	vertex += struct.pack('I', pack_normal(normal))
+	vertex += struct.pack('BBBB', int(color[0] * 255), int(color[1] * 255), int(color[2] * 255), 255)
+	if do_texcoord:
+		vertex += struct.pack('HH', unorm16(uv[0]), unorm16(uv[1]))
+	return vertex
+
+#add a mesh, given the packed vertex of each corner of each of its triangles:
+def add_mesh(name, corners):
+	global data, strings, indices, index, vertex_count, index_count
+
+	#share identical corners:
+	mesh_vertices = {} #packed vertex bytes -> index within this mesh
+	mesh_data = b''
+	mesh_indices = b''
+	for vertex in corners:
+		if vertex not in mesh_vertices:
+			mesh_vertices[vertex] = len(mesh_vertices)
+			mesh_data += vertex
+		mesh_indices += struct.pack('H', mesh_vertices[vertex])
+
+	assert len(mesh_vertices) <= 65536, "mesh '" + name + "' has too many unique vertices for 16-bit indices"
+
+	#record mesh name, vertex range and index range in the index:
 	name_begin = len(strings)
 	strings += bytes(name, "utf8")
 	name_end = len(strings)
@@ -78,68 +138,169 @@ for name in to_write:
 	index += struct.pack('I', name_end)
 
 	index += struct.pack('I', vertex_count)
-	index += struct.pack('I', vertex_count + len(mesh.polygons) * 3)
+	index += struct.pack('I', vertex_count + len(mesh_vertices))
 
-	uvs = None
-	if do_texcoord:
-		if len(obj.data.uv_layers) == 0:
-			print("WARNING: trying to export texcoord data, but object '" + name + "' does not uv data; will output (0.0, 0.0)")
-		else:
-			uvs = obj.data.uv_layers.active.data
-
-	vert_colors = None
-	if do_vertcolor:
-		if len(obj.data.vertex_colors) == 0:
-			print("WARNING: trying to export vertex color data, but object '" + name + "' does not have vertex color data; will output (1.0, 1.0, 1.0)")
-		else:
-			vert_colors = obj.data.vertex_colors.active.data
-
-	#write the mesh:
-	for poly in mesh.polygons:
-		assert(len(poly.loop_indices) == 3)
-		for i in range(0,3):
-			assert(mesh.loops[poly.loop_indices[i]].vertex_index == poly.vertices[i])
-			loop = mesh.loops[poly.loop_indices[i]]
-			vertex = mesh.vertices[loop.vertex_index]
-			for x in mesh.vertices[loop.vertex_index].co:
-				data += struct.pack('f', x)
-			for x in loop.normal:
-				data += struct.pack('f', x)
-			# you should be able to use code much like the texcoord code below.
-			# NOTE: Based on discussion from https://blender.stackexchange.com/questions/909/how-can-i-set-and-get-the-vertex-color-property
-			if do_vertcolor:
+	index += struct.pack('I', index_count)
+	index += struct.pack('I', index_count + len(corners))
+
+	print("  " + str(len(corners)) + " corners -> " + str(len(mesh_vertices)) + " unique vertices")
+
+	data += mesh_data
+	indices += mesh_indices
+	vertex_count += len(mesh_vertices)
+	index_count += len(corners)
+
+if from_dat0:
+	#'dat0' blobs are (float position, float normal, rgba8 color) per corner, then 'str0' names, then an 'idx0' of
+	# (name_begin, name_end, vertex_begin, vertex_end) uint32s per mesh:
+	blob = open(infile, 'rb').read()
+	chunks = {}
+	at = 0
+	while at < len(blob):
+		kind, length = struct.unpack('<4sI', blob[at:at+8])
+		chunks[kind] = blob[at+8:at+8+length]
+		at += 8 + length
+	for kind in [b'dat0', b'str0', b'idx0']:
+		if kind not in chunks:
+			print("'" + infile + "' has no '" + kind.decode('utf8') + "' chunk; is it a 'dat0' blob?")
+			exit(1)
+	old_data = chunks[b'dat0']
+	old_strings = chunks[b'str0']
+	old_index = chunks[b'idx0']
+	for e in range(0, len(old_index), 16):
+		name_begin, name_end, vertex_begin, vertex_end = struct.unpack('<IIII', old_index[e:e+16])
+		name = old_strings[name_begin:name_end].decode('utf8')
+		print("Writing '" + name + "'...")
+		corners = []
+		for v in range(vertex_begin, vertex_end):
+			fields = struct.unpack('<ffffffBBBB', old_data[v*28:(v+1)*28])
+			corners.append(pack_vertex(fields[0:3], fields[3:6], [c / 255.0 for c in fields[6:9]], None))
+		add_mesh(name, corners)
+else:
+	import bpy, mathutils
+
+	import argparse
+
+	bpy.ops.wm.open_mainfile(filepath=infile)
+
+	#names of objects whose meshes to write (not actually the names of the meshes):
+	to_write = []
+	for obj in bpy.data.objects:
+		if obj.type == 'MESH':
+			to_write.append(obj.name)
+
+	#name of the texture an object's polygon uses (or None), as pack-atlas.py would have named it:
+	def texture_name(obj, poly):
+		image = None
+		mesh = obj.data
+		if len(mesh.uv_textures) != 0 and mesh.uv_textures.active.data[poly.index].image != None:
+			image = mesh.uv_textures.active.data[poly.index].image
+		elif poly.material_index < len(obj.material_slots) and obj.material_slots[poly.material_index].material != None:
+			for slot in obj.material_slots[poly.material_index].material.texture_slots:
+				if slot != None and slot.texture != None and slot.texture.type == 'IMAGE' and slot.texture.image != None:
+					image = slot.texture.image
+					break
+		if image == None:
+			return None
+		return os.path.splitext(os.path.basename(bpy.path.abspath(image.filepath)))[0]
+
+	for name in to_write:
+		print("Writing '" + name + "'...")
+		bpy.ops.object.mode_set(mode='OBJECT') #get out of edit mode (just in case)
+		assert(name in bpy.data.objects)
+		obj = bpy.data.objects[name]
+
+		obj.data = obj.data.copy() #make mesh single user, just in case it is shared with another object the script needs to write later.
+
+		#make sure object is on a visible layer:
+		bpy.context.scene.layers = obj.layers
+		#select the object and make it the active object:
+		bpy.ops.object.select_all(action='DESELECT')
+		obj.select = True
+		bpy.context.scene.objects.active = obj
+
+		#subdivide object's mesh into triangles:
+		bpy.ops.object.mode_set(mode='EDIT')
+		bpy.ops.mesh.select_all(action='SELECT')
+		bpy.ops.mesh.quads_convert_to_tris(quad_method='BEAUTY', ngon_method='BEAUTY')
+		bpy.ops.object.mode_set(mode='OBJECT')
+
+		#compute normals (respecting face smoothing):
+		mesh = obj.data
+		mesh.calc_normals_split()
+
+		uvs = None
+		if do_texcoord:
+			if len(mesh.uv_layers) == 0:
+				print("WARNING: trying to export texture coordinates, but object '" + name + "' has no UV layer; it will sample the atlas's white cell")
+			else:
+				uvs = mesh.uv_layers.active.data
+
+		vert_colors = None
+		if do_vertcolor:
+			if len(obj.data.vertex_colors) == 0:
+				print("WARNING: trying to export vertex color data, but object '" + name + "' does not have vertex color data; will output (1.0, 1.0, 1.0)")
+			else:
+				vert_colors = obj.data.vertex_colors.active.data
+
+		#quantize each corner of each triangle (add_mesh shares identical results):
+		corners = []
+		for poly in mesh.polygons:
+			assert(len(poly.loop_indices) == 3)
+			rect = None
+			if uvs != None:
+				texture = texture_name(obj, poly)
+				if texture != None and texture not in atlas:
+					print("WARNING: texture '" + texture + "' (used by '" + name + "') is not in the atlas; it will sample the atlas's white cell")
+				rect = atlas.get(texture) if texture != None else None
+			for i in range(0,3):
+				assert(mesh.loops[poly.loop_indices[i]].vertex_index == poly.vertices[i])
+				loop = mesh.loops[poly.loop_indices[i]]
+				co = mesh.vertices[loop.vertex_index].co
+				# NOTE: Based on discussion from https://blender.stackexchange.com/questions/909/how-can-i-set-and-get-the-vertex-color-property
 				if vert_colors != None:
 					col = vert_colors[poly.loop_indices[i]].color
 				else:
 					col = mathutils.Color((1.0, 1.0, 1.0))
-				data += struct.pack('BBBB', int(col.r * 255), int(col.g * 255), int(col.b * 255), 255)
-
-			if do_texcoord:
-				if uvs != None:
+				#UVs are clamped to their texture's rectangle (an atlas can't repeat textures); (0,0) is the atlas's white cell:
+				u, v = 0.0, 0.0
+				if rect != None:
 					uv = uvs[poly.loop_indices[i]].uv
-					data += struct.pack('ff', uv.x, uv.y)
-				else:
-					data += struct.pack('ff', 0, 0)
-	vertex_count += len(mesh.polygons) * 3
+					u = rect[0] + max(0.0, min(1.0, uv.x)) * (rect[2] - rect[0])
+					v = rect[1] + max(0.0, min(1.0, uv.y)) * (rect[3] - rect[1])
+				corners.append(pack_vertex(co, loop.normal, (col.r, col.g, col.b), (u, v)))
+
+		add_mesh(name, corners)
+
+#pad strings and indices so the chunks that follow stay 4-byte aligned (the runtime uses chunks in-place from a memory map):
+while len(strings) % 4 != 0:
+	strings += b'\0'
+while len(indices) % 4 != 0:
+	indices += b'\0'
 
 #check that we wrote as much data as anticipated:
-assert(vertex_count * (4*3+4*3+4*1) == len(data))
+assert(vertex_count * (2*4+4+4*1+(2*2 if do_texcoord else 0)) == len(data))
+assert(index_count * 2 <= len(indices) < index_count * 2 + 4)
 
 #write the data chunk and index chunk to an output blob:
 blob = open(outfile, 'wb')
 #first chunk: the data
-blob.write(struct.pack('4s',b'dat0')) #type
+blob.write(struct.pack('4s',b'dat2' if do_texcoord else b'dat1')) #type
 blob.write(struct.pack('I', len(data))) #length
 blob.write(data)
 #second chunk: the strings
 blob.write(struct.pack('4s',b'str0')) #type
 blob.write(struct.pack('I', len(strings))) #length
 blob.write(strings)
-#third chunk: the index
-blob.write(struct.pack('4s',b'idx0')) #type
+#third chunk: the triangle indices
+blob.write(struct.pack('4s',b'ind1')) #type
+blob.write(struct.pack('I', len(indices))) #length
+blob.write(indices)
+#fourth chunk: the index
+blob.write(struct.pack('4s',b'idx1')) #type
 blob.write(struct.pack('I', len(index))) #length
 blob.write(index)
 
-print("Wrote " + str(blob.tell()) + " bytes [== " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index] to '" + outfile + "'")
+print("Wrote " + str(blob.tell()) + " bytes [== " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(indices)+8) + " bytes of triangle indices + " + str(len(index)+8) + " bytes of index] to '" + outfile + "'")
 
 blob.close()
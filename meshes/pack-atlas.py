@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+
+#Packs textures into one atlas image, plus a layout file for export-meshes.py --atlas to remap UVs with:
+#python3 pack-atlas.py [--tile <pixels>] <outfile.png> <layout.txt> <name>=<infile.png> [<name>=<infile.png> ...]
+#
+#Each texture is box-filtered down to --tile pixels square (default 512) and placed in a grid of cells, surrounded by
+# a GUTTER-pixel border copied from its edges, so the runtime's first log2(GUTTER)+1 mip levels
+# don't bleed neighboring textures together. The first cell is left white, and holds UV (0,0), so meshes without
+# texture coordinates (and text) sample white.
+#
+#Layout lines are: <name> <u0> <v0> <u1> <v1> -- the texture's rectangle in OpenGL texture coordinates (v up).
+#
+#Only the standard library is used, so the PNG reader handles just what the pbj_assets textures use:
+# 8-bit RGB or RGBA, non-interlaced.
+
+import sys
+import struct
+import zlib
+
+GUTTER = 16 #pixels of copied edge around each tile; must match AtlasMipLevels in Game.cpp (5 levels: 16 -> 1)
+
+args = sys.argv[1:]
+tile = 512
+if len(args) >= 2 and args[0] == '--tile':
+	tile = int(args[1])
+	args = args[2:]
+if len(args) < 3 or any('=' not in a for a in args[2:]) or tile % GUTTER != 0:
+	print("\n\nUsage:\npython3 pack-atlas.py [--tile <pixels, a multiple of " + str(GUTTER) + ">] <outfile.png> <layout.txt> <name>=<infile.png> [<name>=<infile.png> ...]\nPacks textures into an atlas with a white cell at UV (0,0), and writes their UV rectangles to the layout file.\n")
+	exit(1)
+
+outfile = args[0]
+layoutfile = args[1]
+inputs = [a.split('=', 1) for a in args[2:]]
+
+#read a png as (width, height, rows), with rows top-to-bottom lists of (r,g,b,a) tuples:
+def read_png(filename):
+	data = open(filename, 'rb').read()
+	if data[0:8] != b'\x89PNG\r\n\x1a\n':
+		raise Exception("'" + filename + "' is not a png.")
+	at = 8
+	idat = b''
+	width = height = depth = color = interlace = None
+	while at < len(data):
+		length, kind = struct.unpack('>I4s', data[at:at+8])
+		body = data[at+8:at+8+length]
+		at += 12 + length
+		if kind == b'IHDR':
+			width, height, depth, color, _, _, interlace = struct.unpack('>IIBBBBB', body)
+		elif kind == b'IDAT':
+			idat += body
+		elif kind == b'IEND':
+			break
+	if depth != 8 or color not in (2, 6) or interlace != 0:
+		raise Exception("'" + filename + "' should be 8-bit RGB or RGBA, non-interlaced.")
+	channels = 4 if color == 6 else 3
+
+	raw = zlib.decompress(idat)
+	stride = width * channels
+	rows = []
+	prev = bytearray(stride)
+	at = 0
+	for y in range(0, height):
+		kind = raw[at]
+		row = bytearray(raw[at+1:at+1+stride])
+		at += 1 + stride
+		#undo the row's filter (see the PNG spec, section 9):
+		if kind == 1:
+			for i in range(channels, stride):
+				row[i] = (row[i] + row[i-channels]) & 0xff
+		elif kind == 2:
+			for i in range(0, stride):
+				row[i] = (row[i] + prev[i]) & 0xff
+		elif kind == 3:
+			for i in range(0, stride):
+				left = row[i-channels] if i >= channels else 0
+				row[i] = (row[i] + ((left + prev[i]) >> 1)) & 0xff
+		elif kind == 4:
+			for i in range(0, stride):
+				a = row[i-channels] if i >= channels else 0
+				b = prev[i]
+				c = prev[i-channels] if i >= channels else 0
+				p = a + b - c
+				pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+				row[i] = (row[i] + (a if pa <= pb and pa <= pc else (b if pb <= pc else c))) & 0xff
+		elif kind != 0:
+			raise Exception("'" + filename + "' has an unknown row filter.")
+		prev = row
+		if channels == 4:
+			rows.append([tuple(row[i:i+4]) for i in range(0, stride, 4)])
+		else:
+			rows.append([tuple(row[i:i+3]) + (255,) for i in range(0, stride, 3)])
+	return (width, height, rows)
+
+#box-filter rows down to size x size (sizes must divide evenly):
+def shrink(width, height, rows, size):
+	if width % size != 0 or height % size != 0:
+		raise Exception("texture of " + str(width) + "x" + str(height) + " can't be evenly shrunk to " + str(size) + "x" + str(size) + ".")
+	fx, fy = width // size, height // size
+	count = fx * fy
+	out = []
+	for y in range(0, size):
+		src = rows[y*fy:(y+1)*fy]
+		row = []
+		for x in range(0, size):
+			total = [0, 0, 0, 0]
+			for r in src:
+				for p in r[x*fx:(x+1)*fx]:
+					total[0] += p[0]; total[1] += p[1]; total[2] += p[2]; total[3] += p[3]
+			row.append(tuple((t + count // 2) // count for t in total))
+		out.append(row)
+	return out
+
+names = ['(white)'] + [n for (n, _) in inputs]
+cell = tile + 2 * GUTTER
+#squarest grid that fits every cell:
+columns = 1
+while columns * columns < len(names):
+	columns += 1
+grid_rows = (len(names) + columns - 1) // columns
+atlas_width = columns * cell
+atlas_height = grid_rows * cell
+
+#atlas pixels, rows bottom-to-top (so cell (0,0) is at UV (0,0)):
+white = (255, 255, 255, 255)
+atlas = [[white] * atlas_width for _ in range(0, atlas_height)]
+
+layout = ''
+for i in range(1, len(names)):
+	name, filename = inputs[i-1]
+	print("Packing '" + filename + "' as '" + name + "'...")
+	width, height, rows = read_png(filename)
+	pixels = shrink(width, height, rows, tile)
+	pixels.reverse() #now bottom-to-top, like the atlas
+	x0 = (i % columns) * cell + GUTTER
+	y0 = (i // columns) * cell + GUTTER
+	for y in range(-GUTTER, tile + GUTTER):
+		src = pixels[min(max(y, 0), tile - 1)]
+		dst = atlas[y0 + y]
+		for x in range(-GUTTER, tile + GUTTER):
+			dst[x0 + x] = src[min(max(x, 0), tile - 1)]
+	layout += "%s %.8f %.8f %.8f %.8f\n" % (name, x0 / atlas_width, y0 / atlas_height, (x0 + tile) / atlas_width, (y0 + tile) / atlas_height)
+
+#write the atlas as an RGBA png (rows top-to-bottom, unfiltered):
+raw = bytearray()
+for row in reversed(atlas):
+	raw.append(0)
+	for p in row:
+		raw.extend(p)
+def chunk(kind, body):
+	return struct.pack('>I', len(body)) + kind + body + struct.pack('>I', zlib.crc32(kind + body) & 0xffffffff)
+png = b'\x89PNG\r\n\x1a\n'
+png += chunk(b'IHDR', struct.pack('>IIBBBBB', atlas_width, atlas_height, 8, 6, 0, 0, 0))
+png += chunk(b'IDAT', zlib.compress(bytes(raw), 9))
+png += chunk(b'IEND', b'')
+open(outfile, 'wb').write(png)
+open(layoutfile, 'w').write(layout)
+
+print("Wrote " + str(atlas_width) + "x" + str(atlas_height) + " atlas of " + str(len(names) - 1) + " textures (" + str(len(png)) + " bytes) to '" + outfile + "', layout to '" + layoutfile + "'.")
@@ -0,0 +1,135 @@
+#include "mixer.hpp"
+
+#include <SDL.h>
+
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+//requests from the game thread to the audio callback:
+struct PlayCommand {
+	int16_t const *data = nullptr;
+	uint32_t frames = 0;
+	float volume = 1.0f;
+};
+
+//single-producer (game thread), single-consumer (audio callback) ring buffer of commands:
+// the producer only writes 'tail' and the consumer only writes 'head', so no locks are needed.
+#define COMMAND_QUEUE_SIZE 64 //power of two
+static PlayCommand command_queue[COMMAND_QUEUE_SIZE];
+static std::atomic< uint32_t > command_head(0); //next command to consume
+static std::atomic< uint32_t > command_tail(0); //next slot to fill
+
+//samples currently being mixed; only touched by the audio callback:
+#define MAX_VOICES 16
+struct Voice {
+	int16_t const *data = nullptr;
+	uint32_t frames = 0; //frames remaining
+	float volume = 1.0f;
+};
+static Voice voices[MAX_VOICES];
+
+static SDL_AudioDeviceID device = 0;
+
+static void mixer_callback(void *userdata, Uint8 *stream, int len);
+
+void mixer_init() {
+	if (device != 0) return;
+
+	if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+		throw std::runtime_error(std::string("failed to init audio: ") + SDL_GetError());
+	}
+
+	SDL_AudioSpec want;
+	SDL_memset(&want, 0, sizeof(want));
+	want.freq = MIXER_RATE;
+	want.format = AUDIO_S16SYS;
+	want.channels = MIXER_CHANNELS;
+	want.samples = 512; //frames per callback; small enough to keep note onsets snappy
+	want.callback = mixer_callback;
+	want.userdata = NULL;
+
+	//no allowed changes: if the hardware differs, SDL converts behind the scenes
+	device = SDL_OpenAudioDevice(NULL, 0, &want, NULL, 0);
+	if (device == 0) {
+		throw std::runtime_error(std::string("failed to open audio device: ") + SDL_GetError());
+	}
+
+	//start the callback running (it outputs silence until something is played):
+	SDL_PauseAudioDevice(device, 0);
+}
+
+void mixer_shutdown() {
+	if (device == 0) return;
+	SDL_CloseAudioDevice(device); //waits for any callback in progress to return
+	device = 0;
+	for (Voice &v : voices) {
+		v = Voice();
+	}
+	command_head.store(command_tail.load());
+	SDL_QuitSubSystem(SDL_INIT_AUDIO);
+}
+
+bool mixer_play(int16_t const *data, uint32_t frames, float volume) {
+	if (device == 0 || data == nullptr || frames == 0) return false;
+	uint32_t tail = command_tail.load(std::memory_order_relaxed);
+	uint32_t head = command_head.load(std::memory_order_acquire);
+	if (tail - head >= COMMAND_QUEUE_SIZE) {
+		return false; //queue full; audio callback isn't keeping up
+	}
+	PlayCommand &command = command_queue[tail % COMMAND_QUEUE_SIZE];
+	command.data = data;
+	command.frames = frames;
+	command.volume = volume;
+	//publish the command (release: its contents are visible before the new tail):
+	command_tail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+static void mixer_callback(void *userdata, Uint8 *stream, int len) {
+	{ //start any newly requested samples:
+		uint32_t head = command_head.load(std::memory_order_relaxed);
+		uint32_t tail = command_tail.load(std::memory_order_acquire);
+		for (; head != tail; ++head) {
+			PlayCommand const &command = command_queue[head % COMMAND_QUEUE_SIZE];
+			//use a free voice, or else replace the one closest to finishing:
+			Voice *voice = &voices[0];
+			for (Voice &v : voices) {
+				if (v.frames < voice->frames) voice = &v;
+				if (v.frames == 0) break;
+			}
+			voice->data = command.data;
+			voice->frames = command.frames;
+			voice->volume = command.volume;
+		}
+		command_head.store(head, std::memory_order_release);
+	}
+
+	int16_t *out = reinterpret_cast< int16_t * >(stream);
+	uint32_t out_frames = uint32_t(len) / (sizeof(int16_t) * MIXER_CHANNELS);
+
+	//mix in blocks so the accumulator can stay on the stack:
+	#define MIX_BLOCK 256
+	float mix[MIX_BLOCK * MIXER_CHANNELS];
+	for (uint32_t begin = 0; begin < out_frames; begin += MIX_BLOCK) {
+		uint32_t block = std::min< uint32_t >(MIX_BLOCK, out_frames - begin);
+		std::fill(mix, mix + block * MIXER_CHANNELS, 0.0f);
+
+		for (Voice &v : voices) {
+			if (v.frames == 0) continue;
+			uint32_t count = std::min(block, v.frames);
+			for (uint32_t i = 0; i < count * MIXER_CHANNELS; ++i) {
+				mix[i] += v.volume * float(v.data[i]);
+			}
+			v.data += count * MIXER_CHANNELS;
+			v.frames -= count;
+		}
+
+		int16_t *dst = out + begin * MIXER_CHANNELS;
+		for (uint32_t i = 0; i < block * MIXER_CHANNELS; ++i) {
+			dst[i] = int16_t(std::max(-32768.0f, std::min(32767.0f, mix[i])));
+		}
+	}
+	#undef MIX_BLOCK
+}
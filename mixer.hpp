@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+//The mixer owns the audio device: it is opened once by mixer_init, and
+// every sound after that is mixed into one output stream by the audio callback.
+//Samples are interleaved stereo, signed 16-bit, at MIXER_RATE:
+#define MIXER_RATE 44100
+#define MIXER_CHANNELS 2
+
+//open the audio device and start the mixer; throws on failure:
+void mixer_init();
+
+//stop the mixer and close the audio device:
+void mixer_shutdown();
+
+//start playing a sample over whatever else is playing.
+// 'frames' counts stereo frames (so data holds 2 * frames int16_t's); volume scales the sample (1.0 is unchanged).
+// Never blocks or locks: the request goes through a lock-free queue to the audio callback.
+// Returns false (and drops the request) if the queue is full.
+// The sample data must stay valid until mixer_shutdown.
+bool mixer_play(int16_t const *data, uint32_t frames, float volume = 1.0f);
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+//FNV-1a hash of a character range.
+// Written as a single recursive expression so that it is constexpr in C++11.
+constexpr uint32_t fnv1a(char const *str, size_t length, uint32_t hash = 2166136261u) {
+	return length == 0 ? hash : fnv1a(str + 1, length - 1, (hash ^ uint32_t(uint8_t(*str))) * 16777619u);
+}
+
+//NameKey is a name along with its precomputed hash; build one from a literal with the _name suffix:
+//   index.find("Avatar"_name)
+//(the hash is folded at compile time when optimizing, or always when stored in a constexpr NameKey)
+struct NameKey {
+	char const *name;
+	size_t length;
+	uint32_t hash;
+};
+
+constexpr NameKey operator"" _name(char const *str, size_t length) {
+	return NameKey{str, length, fnv1a(str, length)};
+}
+
+//NameIndex maps names to values with an open-addressing (linear probing) hash table.
+// Names are not copied: each entry stores a range into a character buffer
+// (e.g. the 'str0' chunk of a mapped blob) that must outlive the index.
+template< typename V >
+struct NameIndex {
+	NameIndex(char const *names_, size_t names_size_, size_t expected_count) : names(names_), names_size(names_size_) {
+		//keep load factor at or below one half:
+		size_t capacity = 16;
+		while (capacity < 2 * expected_count) capacity *= 2;
+		slots.resize(capacity);
+	}
+
+	//add a name (as a range in the character buffer); returns false if the name was already present:
+	bool insert(uint32_t name_begin, uint32_t name_end, V const &value) {
+		assert(name_begin <= name_end && name_end <= names_size);
+		if (2 * (count + 1) > slots.size()) grow();
+		NameKey key{names + name_begin, name_end - name_begin, fnv1a(names + name_begin, name_end - name_begin)};
+		Slot *slot = probe(key);
+		if (slot->used) return false;
+		slot->used = true;
+		slot->hash = key.hash;
+		slot->name_begin = name_begin;
+		slot->name_end = name_end;
+		slot->value = value;
+		++count;
+		return true;
+	}
+
+	//returns nullptr if the name is not in the index; never allocates:
+	V const *find(NameKey const &key) const {
+		Slot const *slot = probe(key);
+		return slot->used ? &slot->value : nullptr;
+	}
+
+	size_t size() const { return count; }
+
+private:
+	struct Slot {
+		bool used = false;
+		uint32_t hash = 0;
+		uint32_t name_begin = 0;
+		uint32_t name_end = 0;
+		V value = V();
+	};
+
+	char const *names;
+	size_t names_size;
+	size_t count = 0;
+	std::vector< Slot > slots; //size is always a power of two
+
+	//find the slot holding key, or the empty slot where it would go:
+	Slot *probe(NameKey const &key) {
+		return const_cast< Slot * >(static_cast< NameIndex const * >(this)->probe(key));
+	}
+	Slot const *probe(NameKey const &key) const {
+		size_t mask = slots.size() - 1;
+		for (size_t i = key.hash & mask; ; i = (i + 1) & mask) {
+			Slot const &slot = slots[i];
+			if (!slot.used) return &slot;
+			if (slot.hash == key.hash
+			 && slot.name_end - slot.name_begin == key.length
+			 && std::memcmp(names + slot.name_begin, key.name, key.length) == 0) {
+				return &slot;
+			}
+		}
+	}
+
+	void grow() {
+		std::vector< Slot > old;
+		old.swap(slots);
+		slots.resize(old.size() * 2);
+		for (Slot const &s : old) {
+			if (!s.used) continue;
+			NameKey key{names + s.name_begin, s.name_end - s.name_begin, s.hash};
+			*probe(key) = s;
+		}
+	}
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+//OccupancyGrid is one bit per board cell, for constant-time "is anything here?" queries.
+// Level generation maintains these (see generate_layout and mark_layout in game_rules.hpp) so placement,
+// spacing, and drawing never have to search the list of counters.
+struct OccupancyGrid {
+	glm::uvec2 size = glm::uvec2(0);
+	std::vector< uint64_t > bits; //row-major, size.x * size.y bits
+
+	//resize to 'size_' cells and clear them all:
+	void reset(glm::uvec2 size_) {
+		size = size_;
+		bits.assign((size.x * size.y + 63) / 64, 0);
+	}
+
+	bool test(uint32_t x, uint32_t y) const {
+		uint32_t i = y * size.x + x;
+		return (bits[i / 64] >> (i % 64)) & 1;
+	}
+
+	void set(uint32_t x, uint32_t y) {
+		uint32_t i = y * size.x + x;
+		bits[i / 64] |= uint64_t(1) << (i % 64);
+	}
+
+	//set every cell within 'radius' (in both x and y) of (x,y), clipped to the grid:
+	void set_around(uint32_t x, uint32_t y, uint32_t radius) {
+		uint32_t x0 = x - std::min(x, radius), x1 = std::min(size.x - 1, x + radius);
+		uint32_t y0 = y - std::min(y, radius), y1 = std::min(size.y - 1, y + radius);
+		for (uint32_t cy = y0; cy <= y1; ++cy) {
+			for (uint32_t cx = x0; cx <= x1; ++cx) {
+				set(cx, cy);
+			}
+		}
+	}
+};
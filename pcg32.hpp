@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+//Pcg32 is a small, fast, seedable random number generator (PCG-XSH-RR, 64 bits of state, 32-bit output).
+// NOTE: based on the minimal C implementation from http://www.pcg-random.org (Apache 2.0)
+// Each generator owns its state, so generators on different threads never contend, and the same
+// (seed, stream) always produces the same sequence. Generators with different streams are independent,
+// so many boards can share one seed and still get unrelated levels.
+struct Pcg32 {
+	explicit Pcg32(uint64_t seed = 0, uint64_t stream = 0) { reseed(seed, stream); }
+
+	void reseed(uint64_t seed, uint64_t stream = 0) {
+		state = 0;
+		increment = (stream << 1) | 1;
+		(*this)();
+		state += seed;
+		(*this)();
+	}
+
+	//uniformly distributed over all uint32_t values:
+	uint32_t operator()() {
+		uint64_t old = state;
+		state = old * 6364136223846793005ULL + increment;
+		uint32_t xorshifted = uint32_t(((old >> 18) ^ old) >> 27);
+		uint32_t rot = uint32_t(old >> 59);
+		return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+	}
+
+	//uniformly distributed over [0, bound) -- unlike operator()() % bound, without bias toward small values:
+	uint32_t bounded(uint32_t bound) {
+		//values below 2^32 % bound would make the low results more likely; skip them:
+		uint32_t threshold = uint32_t(0x100000000ULL % bound);
+		while (true) {
+			uint32_t r = (*this)();
+			if (r >= threshold) return r % bound;
+		}
+	}
+
+	uint64_t state;
+	uint64_t increment; //always odd; selects the stream
+};
@@ -4,6 +4,8 @@
 #include <vector>
 #include <stdexcept>
 #include <cassert>
+#include <cstdint>
+#include <string>
 
 template< typename T >
 void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *_to) {
@@ -33,3 +35,13 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 		throw std::runtime_error("Failed to read chunk data.");
 	}
 }
+
+//write_chunk is read_chunk's counterpart: a header (magic + byte count), then the data:
+template< typename T >
+void write_chunk(std::ostream &to, std::string const &magic, std::vector< T > const &from) {
+	assert(magic.size() == 4);
+	uint32_t size = uint32_t(from.size() * sizeof(T));
+	to.write(magic.data(), 4);
+	to.write(reinterpret_cast< char const * >(&size), sizeof(size));
+	to.write(reinterpret_cast< char const * >(from.data()), size);
+}
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+
+#Packs .wav files into a sound bank blob that the runtime can use in-place (no runtime conversion):
+#python3 pack-sounds.py <outfile.blob> <name>=<infile.wav> [<name>=<infile.wav> ...]
+#
+#Each sound is converted to the mixer's format (interleaved stereo, signed 16-bit, 44100Hz; see mixer.hpp)
+# and trimmed of leading and trailing silence, with a short fade-out where the tail was cut.
+#
+#Output chunks (each a 4-byte magic, a uint32 length, then data):
+# 'pcm0' -- int16 samples of all sounds, back to back
+# 'str0' -- sound names (padded to a multiple of four bytes)
+# 'snd0' -- per sound: name_begin, name_end, frame_begin, frame_end (uint32s; frames are stereo sample pairs)
+
+import sys
+import struct
+import wave
+
+MIXER_RATE = 44100
+SILENCE = 8 #samples with magnitude at or below this (out of 32767) count as silence
+FADE_FRAMES = 256 #length of fade-out applied at the trimmed end
+
+args = sys.argv[1:]
+if len(args) < 2 or any('=' not in a for a in args[1:]):
+	print("\n\nUsage:\npython3 pack-sounds.py <outfile.blob> <name>=<infile.wav> [<name>=<infile.wav> ...]\nPacks pre-converted, silence-trimmed sounds into a blob, indexed by name.\n")
+	exit(1)
+
+outfile = args[0]
+
+#read a wav file as a list of (left, right) int16 frames:
+def read_frames(filename):
+	w = wave.open(filename, 'rb')
+	channels = w.getnchannels()
+	width = w.getsampwidth()
+	rate = w.getframerate()
+	if rate != MIXER_RATE:
+		raise Exception("'" + filename + "' is " + str(rate) + "Hz; resample it to " + str(MIXER_RATE) + "Hz first.")
+	if channels not in (1, 2):
+		raise Exception("'" + filename + "' has " + str(channels) + " channels; only mono and stereo are supported.")
+	raw = w.readframes(w.getnframes())
+	w.close()
+
+	def sample(offset):
+		if width == 1: #8-bit wavs are unsigned
+			return (raw[offset] - 128) << 8
+		value = int.from_bytes(raw[offset:offset+width], 'little', signed=True)
+		#keep the top 16 bits, rounding to nearest:
+		shift = 8 * (width - 2)
+		if shift > 0:
+			value = (value + (1 << (shift - 1))) >> shift
+		return max(-32768, min(32767, value))
+
+	frames = []
+	stride = width * channels
+	for f in range(0, len(raw) // stride):
+		l = sample(f * stride)
+		r = sample(f * stride + width) if channels == 2 else l
+		frames.append((l, r))
+	return frames
+
+def trim(frames):
+	loud = [i for i in range(0, len(frames)) if max(abs(frames[i][0]), abs(frames[i][1])) > SILENCE]
+	if len(loud) == 0:
+		return []
+	frames = frames[loud[0]:loud[-1]+1]
+	#fade out the last few frames so the cut doesn't click:
+	fade = min(FADE_FRAMES, len(frames))
+	for i in range(0, fade):
+		t = (fade - i) / (fade + 1)
+		l, r = frames[len(frames) - fade + i]
+		frames[len(frames) - fade + i] = (int(round(l * t)), int(round(r * t)))
+	return frames
+
+pcm = b''
+strings = b''
+index = b''
+frame_count = 0
+for arg in args[1:]:
+	name, filename = arg.split('=', 1)
+	frames = read_frames(filename)
+	trimmed = trim(frames)
+	print("Packing '" + name + "' from '" + filename + "': " + str(len(frames)) + " frames -> " + str(len(trimmed)) + " after trimming silence")
+
+	name_begin = len(strings)
+	strings += bytes(name, "utf8")
+	name_end = len(strings)
+	index += struct.pack('IIII', name_begin, name_end, frame_count, frame_count + len(trimmed))
+
+	for l, r in trimmed:
+		pcm += struct.pack('<hh', l, r)
+	frame_count += len(trimmed)
+
+#pad strings so the chunk that follows stays 4-byte aligned (the runtime uses chunks in-place from a memory map):
+while len(strings) % 4 != 0:
+	strings += b'\0'
+
+blob = open(outfile, 'wb')
+blob.write(struct.pack('4s', b'pcm0'))
+blob.write(struct.pack('I', len(pcm)))
+blob.write(pcm)
+blob.write(struct.pack('4s', b'str0'))
+blob.write(struct.pack('I', len(strings)))
+blob.write(strings)
+blob.write(struct.pack('4s', b'snd0'))
+blob.write(struct.pack('I', len(index)))
+blob.write(index)
+
+print("Wrote " + str(blob.tell()) + " bytes [== " + str(len(pcm)+8) + " bytes of samples + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index] to '" + outfile + "'")
+
+blob.close()